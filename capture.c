@@ -0,0 +1,280 @@
+/*
+ * capture.c: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <net/ethernet.h>
+#include <net/if.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/filter.h>
+
+#include "config.h"
+#include "log.h"
+#include "poller.h"
+#include "capture.h"
+
+cSatipCapture *cSatipCapture::instanceS = NULL;
+
+cSatipCapture *cSatipCapture::GetInstance(void)
+{
+  if (!instanceS)
+     instanceS = new cSatipCapture();
+  return instanceS;
+}
+
+bool cSatipCapture::Initialize(void)
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+  if (instanceS && !isempty(SatipConfig.GetCaptureInterface()))
+     return instanceS->Open(SatipConfig.GetCaptureInterface());
+  return true;
+}
+
+void cSatipCapture::Destroy(void)
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+  if (instanceS)
+     instanceS->Close();
+}
+
+cSatipCapture::cSatipCapture()
+: mutexM(),
+  fdM(-1),
+  ringM(NULL),
+  blockM(0),
+  entryCountM(0),
+  packetsM(0),
+  dropsM(0),
+  freezesM(0)
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+  memset(entriesM, 0, sizeof(entriesM));
+}
+
+cSatipCapture::~cSatipCapture()
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+  Close();
+}
+
+bool cSatipCapture::Open(const char *interfaceP)
+{
+  debug1("%s (%s)", __PRETTY_FUNCTION__, interfaceP);
+  cMutexLock MutexLock(&mutexM);
+  if (fdM >= 0)
+     return true;
+  // The link-layer headers are stripped off, so the packets start from the IP header
+  fdM = socket(AF_PACKET, SOCK_DGRAM, htons(ETH_P_IP));
+  ERROR_IF_RET(fdM < 0, "socket(AF_PACKET)", return false);
+  int version = TPACKET_V3;
+  ERROR_IF_FUNC(setsockopt(fdM, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0,
+                "setsockopt(PACKET_VERSION)", Close(), return false);
+  // Nothing gets through before the first registration
+  if (!UpdateFilter()) {
+     Close();
+     return false;
+     }
+  struct tpacket_req3 req;
+  memset(&req, 0, sizeof(req));
+  req.tp_block_size = eBlockSizeB;
+  req.tp_block_nr = eBlockCount;
+  req.tp_frame_size = eFrameSizeB;
+  req.tp_frame_nr = (eBlockSizeB / eFrameSizeB) * eBlockCount;
+  req.tp_retire_blk_tov = eBlockTimeoutMs;
+  ERROR_IF_FUNC(setsockopt(fdM, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0,
+                "setsockopt(PACKET_RX_RING)", Close(), return false);
+  void *ring = mmap(NULL, eBlockSizeB * eBlockCount, PROT_READ | PROT_WRITE, MAP_SHARED, fdM, 0);
+  ERROR_IF_FUNC(ring == MAP_FAILED, "mmap()", Close(), return false);
+  ringM = (unsigned char *)ring;
+  blockM = 0;
+  struct sockaddr_ll addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sll_family = AF_PACKET;
+  addr.sll_protocol = htons(ETH_P_IP);
+  addr.sll_ifindex = if_nametoindex(interfaceP);
+  ERROR_IF_FUNC(addr.sll_ifindex == 0, "if_nametoindex()", Close(), return false);
+  ERROR_IF_FUNC(bind(fdM, (struct sockaddr *)&addr, sizeof(addr)) < 0, "bind()", Close(), return false);
+  if (!cSatipPoller::GetInstance()->Register(*this)) {
+     Close();
+     return false;
+     }
+  info("Capturing multicast streams from %s", interfaceP);
+  return true;
+}
+
+void cSatipCapture::Close(void)
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+  if (fdM >= 0)
+     cSatipPoller::GetInstance()->Unregister(*this);
+  cMutexLock MutexLock(&mutexM);
+  if (ringM) {
+     munmap(ringM, eBlockSizeB * eBlockCount);
+     ringM = NULL;
+     }
+  if (fdM >= 0) {
+     close(fdM);
+     fdM = -1;
+     }
+}
+
+bool cSatipCapture::UpdateFilter(void)
+{
+  debug1("%s entries=%d", __PRETTY_FUNCTION__, entryCountM);
+  // Accept only unfragmented UDP datagrams into the registered groups and ports,
+  // the jumps stay short as every entry has its own return
+  struct sock_filter code[7 + eMaxEntries * 5 + 1];
+  int n = 0;
+  code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 9);            // protocol
+  code[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 1, 0);
+  code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0);
+  code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 6);            // more fragments and fragment offset
+  code[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x3FFF, 0, 1);
+  code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0);
+  code[n++] = (struct sock_filter)BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0);           // header length
+  for (int i = 0; i < entryCountM; ++i) {
+      code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 16);       // destination address
+      code[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ntohl(entriesM[i].streamAddr), 0, 3);
+      code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_H | BPF_IND, 2);        // destination port
+      code[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ntohs(entriesM[i].port), 0, 1);
+      code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0xFFFF);
+      }
+  code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0);
+  struct sock_fprog prog = { (unsigned short)n, code };
+  ERROR_IF_RET(setsockopt(fdM, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0, "setsockopt(SO_ATTACH_FILTER)", return false);
+  return true;
+}
+
+bool cSatipCapture::Register(cSatipPollerIf &pollerP, const char *streamAddrP, const char *sourceAddrP, int portP)
+{
+  debug1("%s (, %s, %s, %d)", __PRETTY_FUNCTION__, streamAddrP, sourceAddrP, portP);
+  cMutexLock MutexLock(&mutexM);
+  if ((fdM < 0) || isempty(streamAddrP) || (portP <= 0))
+     return false;
+  if (entryCountM >= eMaxEntries) {
+     error("Too many multicast streams to capture");
+     return false;
+     }
+  captureEntry *e = &entriesM[entryCountM];
+  e->poller = &pollerP;
+  e->streamAddr = inet_addr(streamAddrP);
+  e->sourceAddr = isempty(sourceAddrP) ? htonl(INADDR_ANY) : inet_addr(sourceAddrP);
+  e->port = htons((uint16_t)(portP & 0xFFFF));
+  if ((e->streamAddr == htonl(INADDR_NONE)) || (e->sourceAddr == htonl(INADDR_NONE))) {
+     error("Invalid multicast address %s for capturing", streamAddrP);
+     return false;
+     }
+  entryCountM++;
+  if (!UpdateFilter()) {
+     entryCountM--;
+     return false;
+     }
+  return true;
+}
+
+bool cSatipCapture::Unregister(cSatipPollerIf &pollerP)
+{
+  debug16("%s", __PRETTY_FUNCTION__);
+  cMutexLock MutexLock(&mutexM);
+  for (int i = 0; i < entryCountM; ++i) {
+      if (entriesM[i].poller == &pollerP) {
+         debug1("%s Removed %s", __PRETTY_FUNCTION__, *(pollerP.ToString()));
+         entriesM[i] = entriesM[--entryCountM];
+         if (fdM >= 0)
+            UpdateFilter();
+         return true;
+         }
+      }
+  return false;
+}
+
+cString cSatipCapture::GetInformation(void)
+{
+  cMutexLock MutexLock(&mutexM);
+  if (fdM >= 0) {
+     struct tpacket_stats_v3 stats;
+     socklen_t len = sizeof(stats);
+     // The kernel resets the counters on every read
+     if (getsockopt(fdM, SOL_PACKET, PACKET_STATISTICS, &stats, &len) == 0) {
+        dropsM += stats.tp_drops;
+        freezesM += stats.tp_freeze_q_cnt;
+        }
+     }
+  return cString::sprintf("packets=%lu drops=%lu freezes=%lu streams=%d", packetsM, dropsM, freezesM, entryCountM);
+}
+
+void cSatipCapture::ProcessPacket(unsigned char *dataP, unsigned int lengthP)
+{
+  if ((lengthP < 20) || ((dataP[0] >> 4) != 4))
+     return;
+  unsigned int headerlen = (dataP[0] & 0x0F) * 4;
+  unsigned int total = min((unsigned int)((dataP[2] << 8) | dataP[3]), lengthP);
+  if (total < headerlen + 8)
+     return;
+  unsigned char *udp = dataP + headerlen;
+  unsigned int udplen = min((unsigned int)((udp[4] << 8) | udp[5]), total - headerlen);
+  if (udplen < 8)
+     return;
+  in_addr_t source, stream;
+  uint16_t port;
+  memcpy(&source, dataP + 12, sizeof(source));
+  memcpy(&stream, dataP + 16, sizeof(stream));
+  memcpy(&port, udp + 2, sizeof(port));
+  for (int i = 0; i < entryCountM; ++i) {
+      captureEntry *e = &entriesM[i];
+      if ((e->streamAddr == stream) && (e->port == port) && ((e->sourceAddr == htonl(INADDR_ANY)) || (e->sourceAddr == source))) {
+         packetsM++;
+         // The devices sharing a stream have their own entries
+         e->poller->Process(udp + 8, udplen - 8);
+         }
+      }
+}
+
+void cSatipCapture::ProcessBlock(struct tpacket_block_desc *blockP)
+{
+  struct tpacket3_hdr *hdr = (struct tpacket3_hdr *)((unsigned char *)blockP + blockP->hdr.bh1.offset_to_first_pkt);
+  for (unsigned int i = 0; i < blockP->hdr.bh1.num_pkts; ++i) {
+      ProcessPacket((unsigned char *)hdr + hdr->tp_net, hdr->tp_snaplen);
+      hdr = (struct tpacket3_hdr *)((unsigned char *)hdr + hdr->tp_next_offset);
+      }
+}
+
+int cSatipCapture::GetFd(void)
+{
+  return fdM;
+}
+
+void cSatipCapture::Process(void)
+{
+  debug16("%s", __PRETTY_FUNCTION__);
+  // Keeps the registered interfaces alive while their data is handed over
+  cMutexLock MutexLock(&mutexM);
+  if (!ringM)
+     return;
+  // Handle all the retired blocks and give them back to the kernel in order
+  for (;;) {
+      struct tpacket_block_desc *block = (struct tpacket_block_desc *)(ringM + blockM * eBlockSizeB);
+      if (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+         break;
+      ProcessBlock(block);
+      __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+      blockM = (blockM + 1) % eBlockCount;
+      }
+}
+
+void cSatipCapture::Process(unsigned char *dataP, int lengthP)
+{
+  debug16("%s (, %d)", __PRETTY_FUNCTION__, lengthP);
+  // A single captured IP packet, as read from the ring
+  cMutexLock MutexLock(&mutexM);
+  if (dataP && (lengthP > 0))
+     ProcessPacket(dataP, (unsigned int)lengthP);
+}
+
+cString cSatipCapture::ToString(void) const
+{
+  return "Capture";
+}
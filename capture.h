@@ -0,0 +1,78 @@
+/*
+ * capture.h: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __SATIP_CAPTURE_H
+#define __SATIP_CAPTURE_H
+
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+
+#include "common.h"
+#include "pollerif.h"
+
+// Receives all the multicast streams of a network interface through a
+// single TPACKET_V3 ring and hands the UDP payloads over to the registered
+// interfaces by their destination address and port. The UDP sockets keep
+// the group memberships, but don't receive any data themselves.
+class cSatipCapture : public cSatipPollerIf {
+private:
+  enum {
+    eBlockSizeB     = 1024 * 1024,
+    eBlockCount     = 32,
+    eFrameSizeB     = 2048,
+    eBlockTimeoutMs = 10,                    // in milliseconds
+    eMaxEntries     = SATIP_MAX_DEVICES * 2  // RTP + RTCP
+  };
+  struct captureEntry {
+    cSatipPollerIf *poller;
+    in_addr_t streamAddr;
+    in_addr_t sourceAddr;
+    uint16_t port;
+  };
+  static cSatipCapture *instanceS;
+  cMutex mutexM;
+  int fdM;
+  unsigned char *ringM;
+  unsigned int blockM;
+  captureEntry entriesM[eMaxEntries];
+  int entryCountM;
+  unsigned long packetsM;
+  unsigned long dropsM;
+  unsigned long freezesM;
+  bool Open(const char *interfaceP);
+  void Close(void);
+  bool UpdateFilter(void);
+  void ProcessBlock(struct tpacket_block_desc *blockP);
+  void ProcessPacket(unsigned char *dataP, unsigned int lengthP);
+  // constructor
+  cSatipCapture();
+  // to prevent copy constructor and assignment
+  cSatipCapture(const cSatipCapture&);
+  cSatipCapture& operator=(const cSatipCapture&);
+
+public:
+  static cSatipCapture *GetInstance(void);
+  static bool Initialize(void);
+  static void Destroy(void);
+  virtual ~cSatipCapture();
+  bool IsActive(void) const { return (fdM >= 0); }
+  bool Register(cSatipPollerIf &pollerP, const char *streamAddrP, const char *sourceAddrP, int portP);
+  bool Unregister(cSatipPollerIf &pollerP);
+  cString GetInformation(void);
+
+  // for internal poller interface
+public:
+  virtual int GetFd(void);
+  virtual void Process(void);
+  virtual void Process(unsigned char *dataP, int lengthP);
+  virtual cString ToString(void) const;
+};
+
+#endif // __SATIP_CAPTURE_H
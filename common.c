@@ -29,6 +29,37 @@ uint8_t payload(const uint8_t *bufP)
   return 184;
 }
 
+bool ts_discontinuity(const uint8_t *bufP)
+{
+  return ((bufP[3] & 0x20) && (bufP[4] > 0) && (bufP[5] & 0x80));
+}
+
+bool ts_continuity_error(const uint8_t *bufP, uint8_t &continuityP)
+{
+  // The continuity counter is incremented only by the packets with payload
+  if (!(bufP[3] & 0x10))
+     return false;
+  uint8_t cc = bufP[3] & 0x0F;
+  uint8_t last = continuityP;
+  continuityP = cc;
+  // A single duplicate packet is allowed and the null packets don't count
+  return ((last != SATIP_NO_CONTINUITY) && (cc != last) && (cc != ((last + 1) & 0x0F)) &&
+          !ts_discontinuity(bufP) && (ts_pid(bufP) != 0x1FFF));
+}
+
+bool ts_has_pcr(const uint8_t *bufP)
+{
+  // adaptation field with at least the flags and PCR fields
+  return ((bufP[3] & 0x20) && (bufP[4] >= 7) && (bufP[4] <= 183) && (bufP[5] & 0x10));
+}
+
+uint64_t ts_pcr(const uint8_t *bufP)
+{
+  // 33-bit base at 90 kHz and 9-bit extension, in 27 MHz units
+  uint64_t base = ((uint64_t)bufP[6] << 25) | ((uint64_t)bufP[7] << 17) | ((uint64_t)bufP[8] << 9) | ((uint64_t)bufP[9] << 1) | (bufP[10] >> 7);
+  return (base * 300) + (((bufP[10] & 0x01) << 8) | bufP[11]);
+}
+
 const char *id_pid(const u_short pidP)
 {
   for (int i = 0; i < SECTION_FILTER_TABLE_SIZE; ++i) {
@@ -77,6 +108,21 @@ cString ChangeCase(const cString &strP, bool upperP)
   return res;
 }
 
+int InsertLargest(int *indexesP, unsigned long *valuesP, int countP, int sizeP, int indexP, unsigned long valueP)
+{
+  // Keeps the indexes of the largest values in descending order by an insertion into a short table
+  int i = min(countP, sizeP - 1);
+  if ((countP == sizeP) && (valuesP[i] >= valueP))
+     return countP;
+  for (; (i > 0) && (valuesP[i - 1] < valueP); --i) {
+      indexesP[i] = indexesP[i - 1];
+      valuesP[i] = valuesP[i - 1];
+      }
+  indexesP[i] = indexP;
+  valuesP[i] = valueP;
+  return (countP < sizeP) ? countP + 1 : countP;
+}
+
 const section_filter_table_type section_filter_table[SECTION_FILTER_TABLE_SIZE] =
 {
   // description                        tag    pid   tid   mask
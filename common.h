@@ -17,6 +17,8 @@
 
 #define SATIP_MAX_DEVICES                MAXDEVICES
 
+#define SATIP_MAX_POLLER_THREADS         SATIP_MAX_DEVICES
+
 #define SATIP_BUFFER_SIZE                KILOBYTE(2048)
 
 #define SATIP_DEVICE_INFO_ALL            0
@@ -25,10 +27,25 @@
 #define SATIP_DEVICE_INFO_FILTERS        3
 #define SATIP_DEVICE_INFO_PROTOCOL       4
 #define SATIP_DEVICE_INFO_BITRATE        5
+#define SATIP_DEVICE_INFO_ZAP            6
+#define SATIP_DEVICE_INFO_RECEIVE        7
+#define SATIP_DEVICE_INFO_MONITOR        8
+#define SATIP_DEVICE_INFO_PCR            9
+
+#define SATIP_ZAP_PHASE_SERVER           0
+#define SATIP_ZAP_PHASE_OPTIONS          1
+#define SATIP_ZAP_PHASE_SETUP            2
+#define SATIP_ZAP_PHASE_PLAY             3
+#define SATIP_ZAP_PHASE_RTP              4
+#define SATIP_ZAP_PHASE_LOCK             5
+#define SATIP_ZAP_PHASE_DELIVERY         6
+#define SATIP_ZAP_PHASE_COUNT            7
 
 #define SATIP_STATS_ACTIVE_PIDS_COUNT    10
 #define SATIP_STATS_ACTIVE_FILTERS_COUNT 10
 
+#define SATIP_NO_CONTINUITY              0xFF
+
 #define MAX_DISABLED_SOURCES_COUNT       25
 #define SECTION_FILTER_TABLE_SIZE        5
 
@@ -134,10 +151,15 @@ public:
 
 uint16_t ts_pid(const uint8_t *bufP);
 uint8_t payload(const uint8_t *bufP);
+bool ts_discontinuity(const uint8_t *bufP);
+bool ts_continuity_error(const uint8_t *bufP, uint8_t &continuityP);
+bool ts_has_pcr(const uint8_t *bufP);
+uint64_t ts_pcr(const uint8_t *bufP);
 const char *id_pid(const u_short pidP);
 char *StripTags(char *strP);
 char *SkipZeroes(const char *strP);
 cString ChangeCase(const cString &strP, bool upperP);
+int InsertLargest(int *indexesP, unsigned long *valuesP, int countP, int sizeP, int indexP, unsigned long valueP);
 
 struct section_filter_table_type {
   const char *description;
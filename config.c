@@ -16,6 +16,7 @@ cSatipConfig::cSatipConfig(void)
   traceModeM(eTraceModeNormal),
   ciExtensionM(0),
   frontendReuseM(1),
+  fastTuneM(0),
   eitScanM(1),
   useBytesM(1),
   portRangeStartM(0),
@@ -24,8 +25,19 @@ cSatipConfig::cSatipConfig(void)
   detachedModeM(false),
   disableServerQuirksM(false),
   useSingleModelServersM(false),
-  rtpRcvBufSizeM(0)
+  zeroCopyM(false),
+  groM(false),
+  pcrAnalysisM(false),
+  pollerThreadsM(1),
+  pollerAffinityM(false),
+  rtpReorderDepthM(0),
+  rtpReorderTimeoutM(50),
+  rtpBatchTimeoutM(0),
+  rtpRcvBufSizeM(0),
+  captureInterfaceM(""),
+  metricsPortM(0)
 {
+  SetMetricsAddress("127.0.0.1");
   for (unsigned int i = 0; i < ELEMENTS(cicamsM); ++i)
       cicamsM[i] = 0;
   for (unsigned int i = 0; i < ELEMENTS(disabledSourcesM); ++i)
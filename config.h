@@ -18,6 +18,7 @@ private:
   unsigned int traceModeM;
   unsigned int ciExtensionM;
   unsigned int frontendReuseM;
+  unsigned int fastTuneM;
   unsigned int eitScanM;
   unsigned int useBytesM;
   unsigned int portRangeStartM;
@@ -26,10 +27,21 @@ private:
   bool detachedModeM;
   bool disableServerQuirksM;
   bool useSingleModelServersM;
+  bool zeroCopyM;
+  bool groM;
+  bool pcrAnalysisM;
+  unsigned int pollerThreadsM;
+  bool pollerAffinityM;
+  unsigned int rtpReorderDepthM;
+  unsigned int rtpReorderTimeoutM;
+  unsigned int rtpBatchTimeoutM;
   int cicamsM[MAX_CICAM_COUNT];
   int disabledSourcesM[MAX_DISABLED_SOURCES_COUNT];
   int disabledFiltersM[SECTION_FILTER_TABLE_SIZE];
   size_t rtpRcvBufSizeM;
+  cString captureInterfaceM;
+  unsigned int metricsPortM;
+  char metricsAddressM[16]; // read by the exporter thread at any time
 
 public:
   enum eOperatingMode {
@@ -76,6 +88,7 @@ public:
   bool IsTraceMode(eTraceMode modeP) const { return (traceModeM & modeP); }
   unsigned int GetCIExtension(void) const { return ciExtensionM; }
   unsigned int GetFrontendReuse(void) const { return frontendReuseM; }
+  unsigned int GetFastTune(void) const { return fastTuneM; }
   int GetCICAM(unsigned int indexP) const;
   unsigned int GetEITScan(void) const { return eitScanM; }
   unsigned int GetUseBytes(void) const { return useBytesM; }
@@ -93,11 +106,23 @@ public:
   unsigned int GetPortRangeStart(void) const { return portRangeStartM; }
   unsigned int GetPortRangeStop(void) const { return portRangeStopM; }
   size_t GetRtpRcvBufSize(void) const { return rtpRcvBufSizeM; }
+  bool GetZeroCopy(void) const { return zeroCopyM; }
+  bool GetGro(void) const { return groM; }
+  bool GetPcrAnalysis(void) const { return pcrAnalysisM; }
+  const char *GetCaptureInterface(void) const { return *captureInterfaceM; }
+  unsigned int GetMetricsPort(void) const { return metricsPortM; }
+  const char *GetMetricsAddress(void) const { return metricsAddressM; }
+  unsigned int GetPollerThreads(void) const { return pollerThreadsM; }
+  bool GetPollerAffinity(void) const { return pollerAffinityM; }
+  unsigned int GetRtpReorderDepth(void) const { return rtpReorderDepthM; }
+  unsigned int GetRtpReorderTimeout(void) const { return rtpReorderTimeoutM; }
+  unsigned int GetRtpBatchTimeout(void) const { return rtpBatchTimeoutM; }
 
   void SetOperatingMode(unsigned int operatingModeP) { operatingModeM = operatingModeP; }
   void SetTraceMode(unsigned int modeP) { traceModeM = (modeP & eTraceModeMask); }
   void SetCIExtension(unsigned int onOffP) { ciExtensionM = onOffP; }
   void SetFrontendReuse(unsigned int onOffP) { frontendReuseM = onOffP; }
+  void SetFastTune(unsigned int onOffP) { fastTuneM = onOffP; }
   void SetCICAM(unsigned int indexP, int cicamP);
   void SetEITScan(unsigned int onOffP) { eitScanM = onOffP; }
   void SetUseBytes(unsigned int onOffP) { useBytesM = onOffP; }
@@ -110,6 +135,17 @@ public:
   void SetPortRangeStart(unsigned int rangeStartP) { portRangeStartM = rangeStartP; }
   void SetPortRangeStop(unsigned int rangeStopP) { portRangeStopM = rangeStopP; }
   void SetRtpRcvBufSize(size_t sizeP) { rtpRcvBufSizeM = sizeP; }
+  void SetZeroCopy(bool onOffP) { zeroCopyM = onOffP; }
+  void SetGro(bool onOffP) { groM = onOffP; }
+  void SetPcrAnalysis(bool onOffP) { pcrAnalysisM = onOffP; }
+  void SetCaptureInterface(const char *interfaceP) { captureInterfaceM = interfaceP; }
+  void SetMetricsPort(unsigned int portP) { metricsPortM = portP; }
+  void SetMetricsAddress(const char *addressP) { strn0cpy(metricsAddressM, addressP, sizeof(metricsAddressM)); }
+  void SetPollerThreads(unsigned int countP) { pollerThreadsM = countP; }
+  void SetPollerAffinity(bool onOffP) { pollerAffinityM = onOffP; }
+  void SetRtpReorderDepth(unsigned int depthP) { rtpReorderDepthM = depthP; }
+  void SetRtpReorderTimeout(unsigned int timeoutP) { rtpReorderTimeoutM = timeoutP; }
+  void SetRtpBatchTimeout(unsigned int timeoutP) { rtpBatchTimeoutM = timeoutP; }
 };
 
 extern cSatipConfig SatipConfig;
@@ -5,12 +5,16 @@
  *
  */
 
+#define __STDC_FORMAT_MACROS // Required for format specifiers
+#include <inttypes.h>
+
 #include <vdr/menu.h> // cRecordControl
 
 #include "config.h"
 #include "discover.h"
 #include "log.h"
 #include "param.h"
+#include "zap.h"
 #include "device.h"
 
 static cSatipDevice * SatipDevicesS[SATIP_MAX_DEVICES] = { NULL };
@@ -25,16 +29,19 @@ cSatipDevice::cSatipDevice(unsigned int indexP)
   deviceNameM(*cString::sprintf("%s %d", *DeviceType(), deviceIndexM)),
   channelM(),
   createdM(0),
-  tunedM()
+  tunedM(),
+  deliveryCallsM(0),
+  deliveredPacketsM(0),
+  deliveryTimerM(eDeliveryReportTimeoutMs),
+  zapTimerM(),
+  zapPendingM(false)
 {
   unsigned int bufsize = (unsigned int)SATIP_BUFFER_SIZE;
   bufsize -= (bufsize % TS_SIZE);
   info("Creating device CardIndex=%d DeviceNumber=%d [device %u]", CardIndex(), DeviceNumber(), deviceIndexM);
-  tsBufferM = new cRingBufferLinear(bufsize + 1, TS_SIZE, false,
-                                   *cString::sprintf("SATIP#%d TS", deviceIndexM));
+  tsBufferM = new cSatipTsBuffer(bufsize, *cString::sprintf("SATIP#%d TS", deviceIndexM));
   if (tsBufferM) {
-     tsBufferM->SetTimeouts(10, 10);
-     tsBufferM->SetIoThrottle();
+     SetBufferSize(tsBufferM->Size());
      pTunerM = new cSatipTuner(*this, tsBufferM->Free());
      }
   // Start section handler
@@ -98,6 +105,22 @@ cSatipDevice *cSatipDevice::GetSatipDevice(int cardIndexP)
   return NULL;
 }
 
+bool cSatipDevice::GetMetrics(unsigned int deviceIndexP, satipMetrics &metricsP)
+{
+  debug16("%s (%u)", __PRETTY_FUNCTION__, deviceIndexP);
+  cSatipDevice *device = (deviceIndexP < SATIP_MAX_DEVICES) ? SatipDevicesS[deviceIndexP] : NULL;
+  if (!device || !device->pTunerM || !device->tsBufferM)
+     return false;
+  memset(&metricsP, 0, sizeof(metricsP));
+  metricsP.deliveredBytes = device->GetBufferBytes();
+  device->GetPidTotals(metricsP.deliveredPackets, metricsP.ccErrors);
+  metricsP.bufferUsed = device->tsBufferM->Available();
+  metricsP.bufferSize = device->tsBufferM->Size();
+  metricsP.bufferOverflows = device->tsBufferM->Overflows();
+  device->pTunerM->GetMetrics(metricsP);
+  return true;
+}
+
 cString cSatipDevice::GetSatipStatus(void)
 {
   cString info = "";
@@ -139,11 +162,12 @@ cString cSatipDevice::GetGeneralInformation(void)
 {
   debug16("%s [device %u]", __PRETTY_FUNCTION__, deviceIndexM);
   LOCK_CHANNELS_READ;
-  return cString::sprintf("SAT>IP device: %d\nCardIndex: %d\nStream: %s\nSignal: %s\nStream bitrate: %s\n%sChannel: %s\n",
+  return cString::sprintf("SAT>IP device: %d\nCardIndex: %d\nStream: %s\nSignal: %s\nStream bitrate: %s\nRTP packets: %s\n%sChannel: %s\n",
                           deviceIndexM, CardIndex(),
                           pTunerM ? *pTunerM->GetInformation() : "",
                           pTunerM ? *pTunerM->GetSignalStatus() : "",
                           pTunerM ? *pTunerM->GetTunerStatistic() : "",
+                          pTunerM ? *pTunerM->GetRtpInformation() : "",
                           *GetBufferStatistic(),
                           *Channels->GetByNumber(cDevice::CurrentChannel())->ToText());
 }
@@ -175,11 +199,24 @@ cString cSatipDevice::GetInformation(unsigned int pageP)
          s = GetFiltersInformation();
          break;
     case SATIP_DEVICE_INFO_PROTOCOL:
-         s = pTunerM ? *pTunerM->GetInformation() : "";
+         s = pTunerM ? *cString::sprintf("%s\nRTP packets: %s", *pTunerM->GetInformation(), *pTunerM->GetRtpInformation()) : "";
          break;
     case SATIP_DEVICE_INFO_BITRATE:
          s = pTunerM ? *pTunerM->GetTunerStatistic() : "";
          break;
+    case SATIP_DEVICE_INFO_RECEIVE:
+         s = pTunerM ? *pTunerM->GetReceiveInformation() : "";
+         break;
+    case SATIP_DEVICE_INFO_MONITOR:
+         s = pTunerM ? *pTunerM->GetMonitorInformation() : "";
+         break;
+    case SATIP_DEVICE_INFO_PCR:
+         s = pTunerM ? *pTunerM->GetPcrInformation() : "";
+         break;
+    case SATIP_DEVICE_INFO_ZAP:
+         s = cString::sprintf("%s%s", *cSatipZapProfiler::GetInstance()->GetDeviceInformation(deviceIndexM),
+                              *cSatipZapProfiler::GetInstance()->GetInformation());
+         break;
     default:
          s = cString::sprintf("%s%s%s",
                               *GetGeneralInformation(),
@@ -356,6 +393,8 @@ bool cSatipDevice::SetChannelDevice(const cChannel *channelP, bool liveViewP)
   cMutexLock MutexLock(&mutexS);  // Global lock to prevent any simultaneous zapping
   debug9("%s (%d, %d) [device %u]", __PRETTY_FUNCTION__, channelP ? channelP->Number() : -1, liveViewP, deviceIndexM);
   if (channelP) {
+     cTimeMs zap(0);
+     cSatipZapProfiler::GetInstance()->Start(deviceIndexM);
      cDvbTransponderParameters dtp(channelP->Parameters());
      cString params = GetTransponderUrlParameters(channelP);
      if (isempty(params)) {
@@ -368,8 +407,11 @@ bool cSatipDevice::SetChannelDevice(const cChannel *channelP, bool liveViewP)
         debug9("%s No suitable server found [device %u]", __PRETTY_FUNCTION__, deviceIndexM);
         return false;
         }
+     cSatipZapProfiler::GetInstance()->Mark(deviceIndexM, SATIP_ZAP_PHASE_SERVER, *cSatipDiscover::GetInstance()->GetServerString(server));
      if (pTunerM && pTunerM->SetSource(server, channelP->Transponder(), *params, deviceIndexM)) {
         channelM = *channelP;
+        zapTimerM = zap;
+        zapPendingM = true;
         deviceNameM = cString::sprintf("%s %d %s", *DeviceType(), deviceIndexM, *cSatipDiscover::GetInstance()->GetServerString(server));
         // Wait for actual channel tuning to prevent simultaneous frontend allocation failures
         tunedM.TimedWait(mutexS, eTuningTimeoutMs);
@@ -479,6 +521,25 @@ void cSatipDevice::WriteData(uchar *bufferP, int lengthP)
      pSectionFilterHandlerM->Write(bufferP, lengthP);
 }
 
+uchar *cSatipDevice::GetWriteBuffer(int &lengthP)
+{
+  debug16("%s [device %u]", __PRETTY_FUNCTION__, deviceIndexM);
+  // The free space is usable even with closed DVR, as the data is then only filtered
+  lengthP = 0;
+  return tsBufferM ? tsBufferM->GetWriteSpace(lengthP) : NULL;
+}
+
+void cSatipDevice::CommitData(uchar *bufferP, int lengthP)
+{
+  debug16("%s [device %u]", __PRETTY_FUNCTION__, deviceIndexM);
+  // Publish the data already received into the TS buffer
+  if (isOpenDvrM && tsBufferM && !tsBufferM->Commit(bufferP, lengthP))
+     tsBufferM->ReportOverflow(lengthP);
+  // Filter the sections
+  if (pSectionFilterHandlerM)
+     pSectionFilterHandlerM->Write(bufferP, lengthP);
+}
+
 int cSatipDevice::GetId(void)
 {
   return deviceIndexM;
@@ -537,21 +598,54 @@ uchar *cSatipDevice::GetData(int *availableP, bool checkTsBuffer)
      uchar *p = tsBufferM->Get(count);
      if (p && count >= TS_SIZE) {
         if (*p != TS_SYNC_BYTE) {
-           for (int i = 1; i < count; i++) {
-               if (p[i] == TS_SYNC_BYTE) {
-                  count = i;
-                  break;
-                  }
-               }
-           tsBufferM->Del(count);
-           info("Skipped %d bytes to sync on TS packet", count);
+           // The buffer holds only whole packets, so keep it aligned
+           tsBufferM->Del(TS_SIZE);
+           info("Skipped %d bytes to sync on TS packet", TS_SIZE);
            return NULL;
            }
         bytesDeliveredM = TS_SIZE;
         if (availableP)
            *availableP = count;
         // Update pid statistics
-        AddPidStatistic(ts_pid(p), payload(p));
+        AddPidStatistic(p);
+        AddDeliveryStatistic(1);
+        CheckZapTime();
+        return p;
+        }
+     }
+  return NULL;
+}
+
+uchar *cSatipDevice::GetDataRun(int &countP)
+{
+  debug16("%s [device %u]", __PRETTY_FUNCTION__, deviceIndexM);
+  countP = 0;
+  if (isOpenDvrM && tsBufferM) {
+     int count = 0;
+     if (bytesDeliveredM) {
+        tsBufferM->Del(bytesDeliveredM);
+        bytesDeliveredM = 0;
+        }
+     uchar *p = tsBufferM->Get(count);
+     if (p && count >= TS_SIZE) {
+        // Deliver the run up to the first packet out of sync
+        int packets = min(count / TS_SIZE, (int)eMaxDeliveryPackets);
+        int n = 0;
+        while ((n < packets) && (p[n * TS_SIZE] == TS_SYNC_BYTE))
+              ++n;
+        if (n == 0) {
+           // The buffer holds only whole packets, so keep it aligned
+           tsBufferM->Del(TS_SIZE);
+           info("Skipped %d bytes to sync on TS packet", TS_SIZE);
+           return NULL;
+           }
+        bytesDeliveredM = n * TS_SIZE;
+        countP = n;
+        // Update pid and buffer statistics once per run
+        AddPidStatistics(p, n);
+        AddBufferStatistic(bytesDeliveredM, tsBufferM->Available());
+        AddDeliveryStatistic(n);
+        CheckZapTime();
         return p;
         }
      }
@@ -566,6 +660,29 @@ void cSatipDevice::SkipData(int countP)
   AddBufferStatistic(countP, tsBufferM->Available());
 }
 
+void cSatipDevice::AddDeliveryStatistic(int packetsP)
+{
+  deliveryCallsM++;
+  deliveredPacketsM += packetsP;
+  if (deliveryTimerM.TimedOut()) {
+     uint64_t elapsed = deliveryTimerM.Elapsed() + eDeliveryReportTimeoutMs;
+     debug6("%s Delivered %lu packets in %lu calls (%.1f packets/call, %lu packets/s) [device %u]", __PRETTY_FUNCTION__,
+            deliveredPacketsM, deliveryCallsM, (double)deliveredPacketsM / deliveryCallsM,
+            (unsigned long)(1000ULL * deliveredPacketsM / elapsed), deviceIndexM);
+     deliveryCallsM = deliveredPacketsM = 0;
+     deliveryTimerM.Set(eDeliveryReportTimeoutMs);
+     }
+}
+
+void cSatipDevice::CheckZapTime(void)
+{
+  // Wait for the packets of the new stream, i.e. until the delivery phase is armed
+  if (zapPendingM && cSatipZapProfiler::GetInstance()->Mark(deviceIndexM, SATIP_ZAP_PHASE_DELIVERY)) {
+     zapPendingM = false;
+     debug6("%s Zap to channel %d took %" PRIu64 " ms until the first TS packet [device %u]", __PRETTY_FUNCTION__, channelM.Number(), zapTimerM.Elapsed(), deviceIndexM);
+     }
+}
+
 bool cSatipDevice::GetTSPacket(uchar *&dataP)
 {
   debug16("%s [device %u]", __PRETTY_FUNCTION__, deviceIndexM);
@@ -590,3 +707,24 @@ bool cSatipDevice::GetTSPacket(uchar *&dataP)
   dataP = NULL;
   return true;
 }
+
+#if defined(APIVERSNUM) && APIVERSNUM >= 20502
+bool cSatipDevice::GetTSPackets(uchar *&dataP, int &countP)
+{
+  debug16("%s [device %u]", __PRETTY_FUNCTION__, deviceIndexM);
+  if (SatipConfig.GetDetachedMode())
+     return false;
+  // Decryption works on single packets only
+  if (cCamSlot *cs = CamSlot()) {
+     if (cs->WantsTsData()) {
+        bool result = GetTSPacket(dataP);
+        countP = dataP ? 1 : 0;
+        return result;
+        }
+     }
+  dataP = tsBufferM ? GetDataRun(countP) : NULL;
+  if (!dataP)
+     countP = 0;
+  return true;
+}
+#endif
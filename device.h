@@ -11,7 +11,9 @@
 #include <vdr/device.h>
 #include "common.h"
 #include "deviceif.h"
+#include "metrics.h"
 #include "tuner.h"
+#include "tsbuffer.h"
 #include "sectionfilter.h"
 #include "statistics.h"
 
@@ -24,12 +26,15 @@ public:
   static unsigned int Count(void);
   static cSatipDevice *GetSatipDevice(int CardIndex);
   static cString GetSatipStatus(void);
+  static bool GetMetrics(unsigned int deviceIndexP, satipMetrics &metricsP);
 
   // private parts
 private:
   enum {
-    eReadyTimeoutMs  = 2000, // in milliseconds
-    eTuningTimeoutMs = 1000  // in milliseconds
+    eReadyTimeoutMs          = 2000,  // in milliseconds
+    eTuningTimeoutMs         = 1000,  // in milliseconds
+    eDeliveryReportTimeoutMs = 10000, // in milliseconds
+    eMaxDeliveryPackets      = 1024   // in TS packets
   };
   unsigned int deviceIndexM;
   int bytesDeliveredM;
@@ -37,11 +42,16 @@ private:
   bool checkTsBufferM;
   cString deviceNameM;
   cChannel channelM;
-  cRingBufferLinear *tsBufferM;
+  cSatipTsBuffer *tsBufferM;
   cSatipTuner *pTunerM;
   cSatipSectionFilterHandler *pSectionFilterHandlerM;
   cTimeMs createdM;
   cCondVar tunedM;
+  unsigned long deliveryCallsM;
+  unsigned long deliveredPacketsM;
+  cTimeMs deliveryTimerM;
+  cTimeMs zapTimerM;
+  bool zapPendingM;
 
   // constructor & destructor
 public:
@@ -86,13 +96,19 @@ protected:
   // for recording
 private:
   uchar *GetData(int *availableP = NULL, bool checkTsBuffer = false);
+  uchar *GetDataRun(int &countP);
   void SkipData(int countP);
+  void AddDeliveryStatistic(int packetsP);
+  void CheckZapTime(void);
 
 protected:
   virtual bool SetPid(cPidHandle *handleP, int typeP, bool onP);
   virtual bool OpenDvr(void);
   virtual void CloseDvr(void);
   virtual bool GetTSPacket(uchar *&dataP);
+#if defined(APIVERSNUM) && APIVERSNUM >= 20502
+  virtual bool GetTSPackets(uchar *&dataP, int &countP);
+#endif
 
   // for section filtering
 public:
@@ -110,6 +126,8 @@ public:
   // for internal device interface
 public:
   virtual void WriteData(u_char *bufferP, int lengthP);
+  virtual u_char *GetWriteBuffer(int &lengthP);
+  virtual void CommitData(u_char *bufferP, int lengthP);
   virtual void SetChannelTuned(void);
   virtual int GetId(void);
   virtual int GetPmtPid(void);
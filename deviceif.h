@@ -13,6 +13,8 @@ public:
   cSatipDeviceIf() {}
   virtual ~cSatipDeviceIf() {}
   virtual void WriteData(u_char *bufferP, int lengthP) = 0;
+  virtual u_char *GetWriteBuffer(int &lengthP) = 0;
+  virtual void CommitData(u_char *bufferP, int lengthP) = 0;
   virtual void SetChannelTuned(void) = 0;
   virtual int GetId(void) = 0;
   virtual int GetPmtPid(void) = 0;
@@ -391,6 +391,13 @@ bool cSatipDiscover::HasServerCI(cSatipServer *serverP)
   return serversM.HasCI(serverP);
 }
 
+bool cSatipDiscover::IsServerAttached(cSatipServer *serverP)
+{
+  debug16("%s", __PRETTY_FUNCTION__);
+  cMutexLock MutexLock(&mutexM);
+  return serversM.IsAttached(serverP);
+}
+
 cString cSatipDiscover::GetSourceAddress(cSatipServer *serverP)
 {
   debug16("%s", __PRETTY_FUNCTION__);
@@ -99,6 +99,7 @@ public:
   void DetachServer(cSatipServer *serverP, int deviceIdP, int transponderP);
   bool IsServerQuirk(cSatipServer *serverP, int quirkP);
   bool HasServerCI(cSatipServer *serverP);
+  bool IsServerAttached(cSatipServer *serverP);
   cString GetServerAddress(cSatipServer *serverP);
   cString GetSourceAddress(cSatipServer *serverP);
   int GetServerPort(cSatipServer *serverP);
@@ -0,0 +1,157 @@
+/*
+ * interleave.c: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <errno.h>
+#include <sys/socket.h>
+
+#include "common.h"
+#include "log.h"
+#include "interleave.h"
+
+cSatipInterleave::cSatipInterleave(cSatipTunerIf &tunerP)
+: tunerM(tunerP),
+  mutexM(),
+  bufferLenM(eBufferSizeB),
+  bufferM(NULL),
+  fdM(-1),
+  suspendedM(0),
+  rtpIdM(0),
+  rtcpIdM(1),
+  skippedM(0)
+{
+  debug1("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
+}
+
+cSatipInterleave::~cSatipInterleave()
+{
+  debug1("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
+  Close();
+}
+
+bool cSatipInterleave::Open(int fdP, unsigned int rtpIdP, unsigned int rtcpIdP)
+{
+  debug1("%s (%d, %u, %u) [device %d]", __PRETTY_FUNCTION__, fdP, rtpIdP, rtcpIdP, tunerM.GetId());
+  cMutexLock MutexLock(&mutexM);
+  if (fdP < 0)
+     return false;
+  // The buffer is needed only while the stream is interleaved
+  if (!bufferM)
+     bufferM = MALLOC(unsigned char, bufferLenM);
+  if (!bufferM) {
+     error("Cannot create interleaved buffer! [device %d]", tunerM.GetId());
+     return false;
+     }
+  fdM = fdP;
+  rtpIdM = rtpIdP;
+  rtcpIdM = rtcpIdP;
+  skippedM = 0;
+  return true;
+}
+
+void cSatipInterleave::Close(void)
+{
+  debug1("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
+  // Waits for any Process() in progress, the socket itself is owned by the RTSP client
+  cMutexLock MutexLock(&mutexM);
+  if (skippedM) {
+     info("Skipped %u bytes of interleaved data [device %d]", skippedM, tunerM.GetId());
+     skippedM = 0;
+     }
+  fdM = -1;
+  FREE_POINTER(bufferM);
+}
+
+void cSatipInterleave::Suspend(void)
+{
+  debug16("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
+  __atomic_store_n(&suspendedM, 1, __ATOMIC_RELEASE);
+  // Wait for any Process() in progress
+  cMutexLock MutexLock(&mutexM);
+}
+
+void cSatipInterleave::Resume(void)
+{
+  debug16("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
+  __atomic_store_n(&suspendedM, 0, __ATOMIC_RELEASE);
+}
+
+int cSatipInterleave::GetFd(void)
+{
+  debug16("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
+  return fdM;
+}
+
+int cSatipInterleave::Parse(unsigned char *bufferP, int lengthP)
+{
+  debug16("%s (, %d) [device %d]", __PRETTY_FUNCTION__, lengthP, tunerM.GetId());
+  int used = 0;
+
+  while (lengthP - used >= eFrameHeaderSizeB) {
+        unsigned char *p = bufferP + used;
+        unsigned int channel = p[1];
+        int count = (p[2] << 8) | p[3];
+        // Anything else than a known channel is out of sync, so look for the next frame
+        if ((p[0] != '$') || ((channel != rtpIdM) && (channel != rtcpIdM))) {
+           unsigned char *q = (unsigned char *)memchr(p + 1, '$', lengthP - used - 1);
+           int skip = q ? (int)(q - p) : lengthP - used;
+           debug7("%s Skipping %d bytes [device %d]", __PRETTY_FUNCTION__, skip, tunerM.GetId());
+           skippedM += skip;
+           used += skip;
+           continue;
+           }
+        // Leave an incomplete frame into the socket until the rest of it arrives
+        if (lengthP - used < eFrameHeaderSizeB + count)
+           break;
+        if (count > 0) {
+           if (channel == rtpIdM)
+              tunerM.ProcessRtpData(p + eFrameHeaderSizeB, count);
+           else
+              tunerM.ProcessRtcpData(p + eFrameHeaderSizeB, count);
+           }
+        used += eFrameHeaderSizeB + count;
+        }
+
+  return used;
+}
+
+void cSatipInterleave::Process(void)
+{
+  debug16("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
+  cMutexLock MutexLock(&mutexM);
+  // The RTSP client reads the socket itself while a request is in progress
+  if ((fdM < 0) || !bufferM || __atomic_load_n(&suspendedM, __ATOMIC_ACQUIRE))
+     return;
+
+  // The socket is edge-triggered, so read until there's nothing complete left
+  for (;;) {
+      ssize_t len = recv(fdM, bufferM, bufferLenM, MSG_PEEK | MSG_DONTWAIT);
+      if (len <= 0) {
+         ERROR_IF((len < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR), "recv() failed");
+         break;
+         }
+      int used = Parse(bufferM, (int)len);
+      if (used <= 0)
+         break;
+      // Drop the handled frames from the socket without copying them again
+      if (recv(fdM, NULL, used, MSG_TRUNC | MSG_DONTWAIT) != used) {
+         error("Cannot consume interleaved data [device %d]", tunerM.GetId());
+         break;
+         }
+      }
+}
+
+void cSatipInterleave::Process(unsigned char *dataP, int lengthP)
+{
+  debug16("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
+  if (dataP && (lengthP > 0))
+     Parse(dataP, lengthP);
+}
+
+cString cSatipInterleave::ToString(void) const
+{
+  return cString::sprintf("Interleave [device %d]", tunerM.GetId());
+}
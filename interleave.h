@@ -0,0 +1,59 @@
+/*
+ * interleave.h: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __SATIP_INTERLEAVE_H
+#define __SATIP_INTERLEAVE_H
+
+#include <vdr/thread.h>
+
+#include "tunerif.h"
+#include "pollerif.h"
+
+// Reader for the RTP and RTCP frames interleaved into the RTSP connection.
+// The frames are only peeked from the socket and consumed once complete,
+// so the socket is always left on a frame boundary for the RTSP client.
+class cSatipInterleave : public cSatipPollerIf {
+private:
+  enum {
+    eFrameHeaderSizeB = 4,    // '$' + channel + length
+    eFrameMaxSizeB    = eFrameHeaderSizeB + 65535,
+    eBufferSizeB      = 4 * eFrameMaxSizeB
+  };
+  cSatipTunerIf &tunerM;
+  cMutex mutexM;
+  unsigned int bufferLenM;
+  unsigned char *bufferM;
+  int fdM;
+  int suspendedM;
+  unsigned int rtpIdM;
+  unsigned int rtcpIdM;
+  unsigned int skippedM;
+  int Parse(unsigned char *bufferP, int lengthP);
+
+  // to prevent copy constructor and assignment
+  cSatipInterleave(const cSatipInterleave&);
+  cSatipInterleave& operator=(const cSatipInterleave&);
+
+public:
+  explicit cSatipInterleave(cSatipTunerIf &tunerP);
+  virtual ~cSatipInterleave();
+  bool Open(int fdP, unsigned int rtpIdP, unsigned int rtcpIdP);
+  void Close(void);
+  bool IsOpen(void) const { return (fdM >= 0); }
+  // The RTSP client owns the socket between these
+  void Suspend(void);
+  void Resume(void);
+
+  // for internal poller interface
+public:
+  virtual int GetFd(void);
+  virtual void Process(void);
+  virtual void Process(unsigned char *dataP, int lengthP);
+  virtual cString ToString(void) const;
+};
+
+#endif // __SATIP_INTERLEAVE_H
@@ -0,0 +1,271 @@
+/*
+ * metrics.c: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "config.h"
+#include "device.h"
+#include "log.h"
+#include "metrics.h"
+
+// The metric families in the order of the output
+enum eMetric {
+  eMetricTuned,
+  eMetricLocked,
+  eMetricStrength,
+  eMetricQuality,
+  eMetricStrengthDBm,
+  eMetricReceivedBytes,
+  eMetricDeliveredBytes,
+  eMetricDeliveredPackets,
+  eMetricCcErrors,
+  eMetricBufferUsed,
+  eMetricBufferSize,
+  eMetricBufferOverflows,
+  eMetricRtpLost,
+  eMetricRtpLate,
+  eMetricRtpDuplicate,
+  eMetricRtpReordered,
+  eMetricSocketDrops,
+  eMetricJitter,
+  eMetricRtspFailures,
+  eMetricCount
+};
+
+static const struct {
+  const char *name;
+  const char *type;
+  const char *help;
+} metricsTable[eMetricCount] = {
+  { "satip_tuned",                   "gauge",   "Whether the device is tuned" },
+  { "satip_locked",                  "gauge",   "Whether the frontend has a lock" },
+  { "satip_signal_strength_percent", "gauge",   "Signal strength reported by the server" },
+  { "satip_signal_quality_percent",  "gauge",   "Signal quality reported by the server" },
+  { "satip_signal_strength_dbm",     "gauge",   "Signal level reported by the server" },
+  { "satip_received_bytes",          "counter", "TS data received from the server" },
+  { "satip_delivered_bytes",         "counter", "TS data delivered to VDR" },
+  { "satip_delivered_packets",       "counter", "TS packets delivered to VDR" },
+  { "satip_continuity_errors",       "counter", "TS continuity counter errors" },
+  { "satip_buffer_used_bytes",       "gauge",   "Fill level of the TS buffer" },
+  { "satip_buffer_size_bytes",       "gauge",   "Size of the TS buffer" },
+  { "satip_buffer_overflows",        "counter", "TS buffer overflows" },
+  { "satip_rtp_lost_packets",        "counter", "RTP packets lost by their sequence number" },
+  { "satip_rtp_late_packets",        "counter", "RTP packets received out of order" },
+  { "satip_rtp_duplicate_packets",   "counter", "RTP packets received twice" },
+  { "satip_rtp_reordered_packets",   "counter", "RTP packets put back in order by the reorder window" },
+  { "satip_socket_drops",            "counter", "RTP packets dropped by the kernel" },
+  { "satip_rtp_jitter_seconds",      "gauge",   "Inter-arrival jitter of the RTP packets" },
+  { "satip_rtsp_request_failures",   "counter", "Failed RTSP requests" },
+};
+
+static cString MetricValue(const satipMetrics &metricsP, int metricP)
+{
+  switch (metricP) {
+    case eMetricTuned:            return cString::sprintf("%d", metricsP.tuned);
+    case eMetricLocked:           return cString::sprintf("%d", metricsP.locked);
+    case eMetricStrength:         return cString::sprintf("%d", metricsP.strength);
+    case eMetricQuality:          return cString::sprintf("%d", metricsP.quality);
+    case eMetricStrengthDBm:      return cString::sprintf("%.2f", metricsP.strengthDBm);
+    case eMetricReceivedBytes:    return cString::sprintf("%lu", metricsP.receivedBytes);
+    case eMetricDeliveredBytes:   return cString::sprintf("%lu", metricsP.deliveredBytes);
+    case eMetricDeliveredPackets: return cString::sprintf("%lu", metricsP.deliveredPackets);
+    case eMetricCcErrors:         return cString::sprintf("%lu", metricsP.ccErrors);
+    case eMetricBufferUsed:       return cString::sprintf("%d", metricsP.bufferUsed);
+    case eMetricBufferSize:       return cString::sprintf("%d", metricsP.bufferSize);
+    case eMetricBufferOverflows:  return cString::sprintf("%lu", metricsP.bufferOverflows);
+    case eMetricRtpLost:          return cString::sprintf("%u", metricsP.rtpLost);
+    case eMetricRtpLate:          return cString::sprintf("%u", metricsP.rtpLate);
+    case eMetricRtpDuplicate:     return cString::sprintf("%u", metricsP.rtpDuplicate);
+    case eMetricRtpReordered:     return cString::sprintf("%u", metricsP.rtpReordered);
+    case eMetricSocketDrops:      return cString::sprintf("%lu", metricsP.socketDrops);
+    case eMetricJitter:           return cString::sprintf("%.9f", metricsP.jitterNs / 1000000000.0);
+    case eMetricRtspFailures:     return cString::sprintf("%lu", metricsP.rtspFailures);
+    default:                      break;
+    }
+  return "0";
+}
+
+static bool SendAll(int fdP, const char *dataP, size_t lengthP)
+{
+  while (lengthP > 0) {
+        ssize_t len = send(fdP, dataP, lengthP, MSG_NOSIGNAL);
+        if (len <= 0)
+           return false;
+        dataP += len;
+        lengthP -= len;
+        }
+  return true;
+}
+
+cSatipMetrics *cSatipMetrics::instanceS = NULL;
+
+cSatipMetrics *cSatipMetrics::GetInstance(void)
+{
+  if (!instanceS)
+     instanceS = new cSatipMetrics();
+  return instanceS;
+}
+
+bool cSatipMetrics::Initialize(void)
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+  // The endpoint follows the setup, so the thread runs even if it's disabled
+  if (instanceS)
+     instanceS->Start();
+  return true;
+}
+
+void cSatipMetrics::Destroy(void)
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+  if (instanceS) {
+     instanceS->sleepM.Signal();
+     instanceS->Cancel(3);
+     instanceS->Close();
+     }
+}
+
+cSatipMetrics::cSatipMetrics()
+: cThread("SATIP metrics"),
+  sleepM(),
+  fdM(-1),
+  addressM(""),
+  portM(0)
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+}
+
+cSatipMetrics::~cSatipMetrics()
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+  sleepM.Signal();
+  if (Running())
+     Cancel(3);
+  Close();
+}
+
+bool cSatipMetrics::Listen(const char *addressP, unsigned int portP)
+{
+  debug1("%s (%s, %u)", __PRETTY_FUNCTION__, addressP, portP);
+  struct sockaddr_in addr;
+  int yes = 1;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons((uint16_t)portP);
+  if (isempty(addressP))
+     addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  else if (inet_pton(AF_INET, addressP, &addr.sin_addr) != 1) {
+     error("Invalid metrics address %s", addressP);
+     return false;
+     }
+  fdM = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  ERROR_IF_RET(fdM < 0, "socket()", return false);
+  ERROR_IF_FUNC(setsockopt(fdM, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) < 0, "setsockopt(SO_REUSEADDR)", Close(), return false);
+  ERROR_IF_FUNC(bind(fdM, (struct sockaddr *)&addr, sizeof(addr)) < 0, "bind()", Close(), return false);
+  ERROR_IF_FUNC(listen(fdM, SOMAXCONN) < 0, "listen()", Close(), return false);
+  info("Serving metrics at http://%s:%u/metrics", isempty(addressP) ? "0.0.0.0" : addressP, portP);
+
+  return true;
+}
+
+void cSatipMetrics::Close(void)
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+  if (fdM >= 0) {
+     close(fdM);
+     fdM = -1;
+     }
+}
+
+void cSatipMetrics::Render(cSatipMemoryBuffer &bufferP)
+{
+  debug16("%s", __PRETTY_FUNCTION__);
+  satipMetrics metrics[SATIP_MAX_DEVICES];
+  bool valid[SATIP_MAX_DEVICES];
+  char line[eMaxLineSizeB];
+  int len;
+
+  // Take the snapshots first to keep the families consistent
+  for (int i = 0; i < SATIP_MAX_DEVICES; ++i)
+      valid[i] = cSatipDevice::GetMetrics(i, metrics[i]);
+  for (int m = 0; m < eMetricCount; ++m) {
+      len = snprintf(line, sizeof(line), "# TYPE %s %s\n# HELP %s %s.\n", metricsTable[m].name, metricsTable[m].type, metricsTable[m].name, metricsTable[m].help);
+      bufferP.Add(line, min(len, (int)sizeof(line) - 1));
+      for (int i = 0; i < SATIP_MAX_DEVICES; ++i) {
+          if (!valid[i])
+             continue;
+          len = snprintf(line, sizeof(line), "%s%s{device=\"%d\"} %s\n", metricsTable[m].name, strcmp(metricsTable[m].type, "counter") ? "" : "_total", i, *MetricValue(metrics[i], m));
+          bufferP.Add(line, min(len, (int)sizeof(line) - 1));
+          }
+      }
+  // The RTSP latencies as a summary without quantiles
+  len = snprintf(line, sizeof(line), "# TYPE satip_rtsp_request_duration_seconds summary\n# HELP satip_rtsp_request_duration_seconds Round trip time of the RTSP requests.\n");
+  bufferP.Add(line, min(len, (int)sizeof(line) - 1));
+  for (int i = 0; i < SATIP_MAX_DEVICES; ++i) {
+      if (!valid[i])
+         continue;
+      len = snprintf(line, sizeof(line), "satip_rtsp_request_duration_seconds_count{device=\"%d\"} %lu\nsatip_rtsp_request_duration_seconds_sum{device=\"%d\"} %.3f\n",
+                     i, metrics[i].rtspRequests, i, metrics[i].rtspTimeMs / 1000.0);
+      bufferP.Add(line, min(len, (int)sizeof(line) - 1));
+      }
+  len = snprintf(line, sizeof(line), "# EOF\n");
+  bufferP.Add(line, len);
+}
+
+void cSatipMetrics::Serve(void)
+{
+  debug16("%s", __PRETTY_FUNCTION__);
+  struct timeval tv = { eClientTimeoutMs / 1000, (eClientTimeoutMs % 1000) * 1000 };
+  char request[eRequestSizeB];
+  int fd = accept4(fdM, NULL, NULL, SOCK_CLOEXEC);
+
+  if (fd < 0)
+     return;
+  // A stalled client must not keep the others waiting
+  ERROR_IF(setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0, "setsockopt(SO_RCVTIMEO)");
+  ERROR_IF(setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) < 0, "setsockopt(SO_SNDTIMEO)");
+  ssize_t len = recv(fd, request, sizeof(request) - 1, 0);
+  if (len > 0) {
+     cSatipMemoryBuffer body;
+     const char *status = "200 OK";
+     request[len] = 0;
+     if (startswith(request, "GET /metrics") && strchr(" ?", request[12]))
+        Render(body);
+     else
+        status = "404 Not Found";
+     cString header = cString::sprintf("HTTP/1.0 %s\r\nContent-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", status, body.Size());
+     if (SendAll(fd, *header, strlen(*header)) && body.Size())
+        SendAll(fd, body.Data(), body.Size());
+     }
+  close(fd);
+}
+
+void cSatipMetrics::Action(void)
+{
+  debug1("%s Entering", __PRETTY_FUNCTION__);
+  // Do the thread loop
+  while (Running()) {
+        // Follow any changes in the setup
+        if ((portM != SatipConfig.GetMetricsPort()) || strcmp(*addressM, SatipConfig.GetMetricsAddress())) {
+           Close();
+           portM = SatipConfig.GetMetricsPort();
+           addressM = SatipConfig.GetMetricsAddress();
+           if (portM)
+              Listen(*addressM, portM);
+           }
+        if (fdM < 0) {
+           sleepM.Wait(eSleepTimeoutMs);
+           continue;
+           }
+        struct pollfd pfd = { fdM, POLLIN, 0 };
+        if ((poll(&pfd, 1, eSleepTimeoutMs) > 0) && (pfd.revents & POLLIN))
+           Serve();
+        }
+  debug1("%s Exiting", __PRETTY_FUNCTION__);
+}
@@ -0,0 +1,78 @@
+/*
+ * metrics.h: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __SATIP_METRICS_H
+#define __SATIP_METRICS_H
+
+#include <arpa/inet.h>
+
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+
+#include "common.h"
+
+// Counters of a device, read without locking the data path
+struct satipMetrics {
+  bool tuned;
+  bool locked;
+  int strength;
+  int quality;
+  double strengthDBm;
+  unsigned long receivedBytes;
+  unsigned long deliveredBytes;
+  unsigned long deliveredPackets;
+  unsigned long ccErrors;
+  int bufferUsed;
+  int bufferSize;
+  unsigned long bufferOverflows;
+  unsigned int rtpLost;
+  unsigned int rtpLate;
+  unsigned int rtpDuplicate;
+  unsigned int rtpReordered;
+  unsigned long socketDrops;
+  int64_t jitterNs;
+  unsigned long rtspRequests;
+  unsigned long rtspFailures;
+  unsigned long rtspTimeMs;
+};
+
+// Serves the statistics of all the devices in the OpenMetrics text format
+// via a minimal HTTP endpoint, e.g. for Prometheus.
+class cSatipMetrics : public cThread {
+private:
+  enum {
+    eSleepTimeoutMs   = 1000, // in milliseconds
+    eClientTimeoutMs  = 1000, // in milliseconds
+    eRequestSizeB     = 1024,
+    eMaxLineSizeB     = 256
+  };
+  static cSatipMetrics *instanceS;
+  cCondWait sleepM;
+  int fdM;
+  cString addressM;
+  unsigned int portM;
+  bool Listen(const char *addressP, unsigned int portP);
+  void Close(void);
+  void Serve(void);
+  void Render(cSatipMemoryBuffer &bufferP);
+  // constructor
+  cSatipMetrics();
+  // to prevent copy constructor and assignment
+  cSatipMetrics(const cSatipMetrics&);
+  cSatipMetrics& operator=(const cSatipMetrics&);
+
+protected:
+  virtual void Action(void);
+
+public:
+  static cSatipMetrics *GetInstance(void);
+  static bool Initialize(void);
+  static void Destroy(void);
+  virtual ~cSatipMetrics();
+};
+
+#endif // __SATIP_METRICS_H
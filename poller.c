@@ -7,13 +7,410 @@
 
 #define __STDC_FORMAT_MACROS // Required for format specifiers
 #include <inttypes.h>
+#include <poll.h>
+#include <sched.h>
 #include <sys/epoll.h>
+#ifdef USE_LIBURING
+#include <sys/eventfd.h>
+#endif
 
 #include "config.h"
 #include "common.h"
 #include "log.h"
 #include "poller.h"
 
+// --- cSatipPollerThread -----------------------------------------------------
+
+cSatipPollerThread::cSatipPollerThread(int indexP, int cpuP)
+: cThread(*cString::sprintf("SATIP poller %d", indexP)),
+  indexM(indexP),
+  cpuM(cpuP),
+  fdM(epoll_create(eMaxFileDescriptors)),
+  pollersM(),
+  wakeupsM(0),
+  eventsM(0),
+  reportM(eReportIntervalMs)
+#ifdef USE_LIBURING
+  , ringMutexM(),
+  useRingM(false),
+  wakeupFdM(-1)
+#endif
+{
+  debug1("%s (%d, %d)", __PRETTY_FUNCTION__, indexP, cpuP);
+#ifdef USE_LIBURING
+  memset(slotsM, 0, sizeof(slotsM));
+  // Only the ring thread touches the submission queue, the others wake it up through an eventfd
+  wakeupFdM = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  int ret = (wakeupFdM >= 0) ? io_uring_queue_init(eRingEntries, &ringM, 0) : -errno;
+  if (ret < 0) {
+     char tmp[64];
+     error("Cannot create io_uring, using epoll instead: %s [poller %d]", strerror_r(-ret, tmp, sizeof(tmp)), indexM);
+     if (wakeupFdM >= 0) {
+        close(wakeupFdM);
+        wakeupFdM = -1;
+        }
+     }
+  else
+     useRingM = true;
+#endif
+}
+
+cSatipPollerThread::~cSatipPollerThread()
+{
+  debug1("%s [poller %d]", __PRETTY_FUNCTION__, indexM);
+  Stop();
+#ifdef USE_LIBURING
+  if (useRingM) {
+     for (int i = 0; i < eMaxRingSlots; ++i)
+         FreeRingBuffers(i);
+     io_uring_queue_exit(&ringM);
+     close(wakeupFdM);
+     }
+#endif
+  close(fdM);
+}
+
+void cSatipPollerThread::Report(unsigned int eventsP)
+{
+  // Wakeup statistics for comparing the backends
+  wakeupsM++;
+  eventsM += eventsP;
+  if (reportM.TimedOut()) {
+     debug6("%s %u wakeups with %u events (%.1f per wakeup) [poller %d]", __PRETTY_FUNCTION__, wakeupsM, eventsM,
+            wakeupsM ? (double)eventsM / wakeupsM : 0.0, indexM);
+     wakeupsM = 0;
+     eventsM = 0;
+     reportM.Set(eReportIntervalMs);
+     }
+}
+
+void cSatipPollerThread::Stop(void)
+{
+  debug1("%s [poller %d]", __PRETTY_FUNCTION__, indexM);
+  if (Running())
+     Cancel(3);
+}
+
+void cSatipPollerThread::Action(void)
+{
+  debug1("%s Entering [poller %d]", __PRETTY_FUNCTION__, indexM);
+  struct epoll_event events[eMaxFileDescriptors];
+  uint64_t maxElapsed = 0;
+  // Increase priority
+  SetPriority(-1);
+  // Pin the thread into a dedicated core if requested
+  if (cpuM >= 0) {
+     cpu_set_t cpus;
+     CPU_ZERO(&cpus);
+     CPU_SET(cpuM, &cpus);
+     ERROR_IF(sched_setaffinity(0, sizeof(cpus), &cpus) == -1, "sched_setaffinity() failed");
+     }
+  // Do the thread loop
+#ifdef USE_LIBURING
+  if (useRingM)
+     RingAction();
+  else
+#endif
+  while (Running()) {
+        int nfds = epoll_wait(fdM, events, eMaxFileDescriptors, -1);
+        ERROR_IF_FUNC((nfds == -1 && errno != EINTR), "epoll_wait() failed", break, ;);
+        if (nfds > 0)
+           Report(nfds);
+        for (int i = 0; i < nfds; ++i) {
+            cSatipPollerIf* poll = reinterpret_cast<cSatipPollerIf *>(events[i].data.ptr);
+            if (poll) {
+               uint64_t elapsed;
+               cTimeMs processing(0);
+               poll->Process();
+               elapsed = processing.Elapsed();
+               if (elapsed > maxElapsed) {
+                  maxElapsed = elapsed;
+                  debug1("%s Processing %s took %" PRIu64 " ms [poller %d]", __PRETTY_FUNCTION__, *(poll->ToString()), maxElapsed, indexM);
+                  }
+               }
+           }
+        }
+  debug1("%s Exiting [poller %d]", __PRETTY_FUNCTION__, indexM);
+}
+
+bool cSatipPollerThread::Register(cSatipPollerIf &pollerP)
+{
+  debug1("%s fd=%d [poller %d]", __PRETTY_FUNCTION__, pollerP.GetFd(), indexM);
+
+#ifdef USE_LIBURING
+  if (useRingM) {
+     cMutexLock MutexLock(&ringMutexM);
+     int slot = -1;
+     for (int i = 0; i < eMaxRingSlots; ++i) {
+         if (slotsM[i].busy && (slotsM[i].poller == &pollerP))
+            return true;
+         if ((slot < 0) && !slotsM[i].busy)
+            slot = i;
+         }
+     if (slot < 0) {
+        error("No free io_uring slots for fd=%d [poller %d]", pollerP.GetFd(), indexM);
+        return false;
+        }
+     ringSlot *s = &slotsM[slot];
+     s->fd = pollerP.GetFd();
+     // Datagram interfaces get a buffer ring, the rest are only polled for readiness
+     if (pollerP.GetDatagramSize() && !SetupRingBuffers(slot, pollerP.GetDatagramSize()))
+        info("Cannot create io_uring buffers for %s, polling it instead [poller %d]", *(pollerP.ToString()), indexM);
+     s->poller = &pollerP;
+     s->busy = true;
+     s->armPending = true;
+     s->cancelPending = false;
+     pollersM.AppendUnique(&pollerP);
+     WakeupRing();
+     debug1("%s Added interface fd=%d slot=%d buffers=%u [poller %d]", __PRETTY_FUNCTION__, s->fd, slot, s->bufferCount, indexM);
+     return true;
+     }
+#endif
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.ptr = &pollerP;
+  ERROR_IF_RET(epoll_ctl(fdM, EPOLL_CTL_ADD, pollerP.GetFd(), &ev) == -1, "epoll_ctl(EPOLL_CTL_ADD) failed", return false);
+  pollersM.AppendUnique(&pollerP);
+  debug1("%s Added interface fd=%d [poller %d]", __PRETTY_FUNCTION__, pollerP.GetFd(), indexM);
+
+  return true;
+}
+
+bool cSatipPollerThread::Unregister(cSatipPollerIf &pollerP)
+{
+  debug1("%s fd=%d [poller %d]", __PRETTY_FUNCTION__, pollerP.GetFd(), indexM);
+  pollersM.RemoveElement(&pollerP);
+#ifdef USE_LIBURING
+  if (useRingM) {
+     cMutexLock MutexLock(&ringMutexM);
+     for (int i = 0; i < eMaxRingSlots; ++i) {
+         if (slotsM[i].busy && (slotsM[i].poller == &pollerP)) {
+            // No more callbacks once the lock is released
+            slotsM[i].poller = NULL;
+            if (slotsM[i].armPending) {
+               // Never submitted, so there's nothing to cancel
+               slotsM[i].armPending = false;
+               slotsM[i].busy = false;
+               FreeRingBuffers(i);
+               }
+            else {
+               // The slot gets released by the final completion of the cancelled request
+               slotsM[i].cancelPending = true;
+               WakeupRing();
+               }
+            debug1("%s Removed interface fd=%d slot=%d [poller %d]", __PRETTY_FUNCTION__, slotsM[i].fd, i, indexM);
+            return true;
+            }
+         }
+     return false;
+     }
+#endif
+  ERROR_IF_RET((epoll_ctl(fdM, EPOLL_CTL_DEL, pollerP.GetFd(), NULL) == -1), "epoll_ctl(EPOLL_CTL_DEL) failed", return false);
+  debug1("%s Removed interface fd=%d [poller %d]", __PRETTY_FUNCTION__, pollerP.GetFd(), indexM);
+
+  return true;
+}
+
+#ifdef USE_LIBURING
+bool cSatipPollerThread::SetupRingBuffers(int slotP, unsigned int sizeP)
+{
+  ringSlot *s = &slotsM[slotP];
+  int ret = 0;
+  // Each buffer holds the receive header, the control data and the datagram itself
+  s->bufferSize = (unsigned int)sizeof(struct io_uring_recvmsg_out) + eRingControlSizeB + sizeP;
+  s->bufferCount = eRingMaxBuffers;
+  while ((s->bufferCount > eRingMinBuffers) && (s->bufferCount * s->bufferSize > eRingPoolSizeB))
+        s->bufferCount >>= 1;
+  s->buffers = MALLOC(unsigned char, s->bufferCount * s->bufferSize);
+  s->bufRing = s->buffers ? io_uring_setup_buf_ring(&ringM, s->bufferCount, slotP, 0, &ret) : NULL;
+  if (!s->bufRing) {
+     debug1("%s Cannot create buffer ring: %d [poller %d]", __PRETTY_FUNCTION__, ret, indexM);
+     FREE_POINTER(s->buffers);
+     s->bufferCount = 0;
+     return false;
+     }
+  for (unsigned int i = 0; i < s->bufferCount; ++i)
+      io_uring_buf_ring_add(s->bufRing, s->buffers + i * s->bufferSize, s->bufferSize, i, io_uring_buf_ring_mask(s->bufferCount), i);
+  io_uring_buf_ring_advance(s->bufRing, s->bufferCount);
+  memset(&s->msgh, 0, sizeof(s->msgh));
+  s->msgh.msg_controllen = eRingControlSizeB;
+  return true;
+}
+
+void cSatipPollerThread::FreeRingBuffers(int slotP)
+{
+  ringSlot *s = &slotsM[slotP];
+  if (s->bufRing) {
+     io_uring_free_buf_ring(&ringM, s->bufRing, s->bufferCount, slotP);
+     s->bufRing = NULL;
+     }
+  FREE_POINTER(s->buffers);
+  s->bufferCount = 0;
+}
+
+struct io_uring_sqe *cSatipPollerThread::GetRingSqe(void)
+{
+  struct io_uring_sqe *sqe = io_uring_get_sqe(&ringM);
+  if (!sqe) {
+     // Make room by flushing the queued requests
+     io_uring_submit(&ringM);
+     sqe = io_uring_get_sqe(&ringM);
+     }
+  return sqe;
+}
+
+bool cSatipPollerThread::ArmRing(int slotP)
+{
+  // Called only by the ring thread, the request is submitted by SubmitRing()
+  ringSlot *s = &slotsM[slotP];
+  struct io_uring_sqe *sqe = GetRingSqe();
+  if (!sqe)
+     return false;
+  if (s->bufRing) {
+     io_uring_prep_recvmsg_multishot(sqe, s->fd, &s->msgh, 0);
+     sqe->flags |= IOSQE_BUFFER_SELECT;
+     sqe->buf_group = slotP;
+     }
+  else
+     io_uring_prep_poll_multishot(sqe, s->fd, POLLIN);
+  io_uring_sqe_set_data64(sqe, slotP);
+  return true;
+}
+
+bool cSatipPollerThread::ArmWakeup(void)
+{
+  struct io_uring_sqe *sqe = GetRingSqe();
+  if (!sqe)
+     return false;
+  io_uring_prep_poll_multishot(sqe, wakeupFdM, POLLIN);
+  io_uring_sqe_set_data64(sqe, eRingWakeupData);
+  return true;
+}
+
+void cSatipPollerThread::WakeupRing(void)
+{
+  uint64_t one = 1;
+  ERROR_IF(write(wakeupFdM, &one, sizeof(one)) < 0 && (errno != EAGAIN), "write(eventfd) failed");
+}
+
+void cSatipPollerThread::SubmitRing(void)
+{
+  // Hand the requests queued by the other threads over to the kernel
+  cMutexLock MutexLock(&ringMutexM);
+  for (int i = 0; i < eMaxRingSlots; ++i) {
+      ringSlot *s = &slotsM[i];
+      if (s->armPending) {
+         s->armPending = false;
+         if (!ArmRing(i)) {
+            error("Cannot add %s into io_uring [poller %d]", *(s->poller->ToString()), indexM);
+            pollersM.RemoveElement(s->poller);
+            FreeRingBuffers(i);
+            s->poller = NULL;
+            s->busy = false;
+            }
+         }
+      else if (s->cancelPending) {
+         struct io_uring_sqe *sqe = GetRingSqe();
+         if (!sqe)
+            break;
+         s->cancelPending = false;
+         io_uring_prep_cancel64(sqe, i, 0);
+         io_uring_sqe_set_data64(sqe, eRingCancelData);
+         }
+      }
+  io_uring_submit(&ringM);
+}
+
+void cSatipPollerThread::ProcessRing(struct io_uring_cqe *cqeP)
+{
+  uint64_t slot = io_uring_cqe_get_data64(cqeP);
+  if (slot == eRingWakeupData) {
+     uint64_t value;
+     // Just drain the counter, the queued requests are submitted after the completions
+     ERROR_IF(read(wakeupFdM, &value, sizeof(value)) < 0 && (errno != EAGAIN), "read(eventfd) failed");
+     if (!(cqeP->flags & IORING_CQE_F_MORE) && !ArmWakeup())
+        error("Cannot re-arm the wakeup in io_uring [poller %d]", indexM);
+     return;
+     }
+  // Ignore the completions of the cancel requests
+  if (slot >= eMaxRingSlots)
+     return;
+  ringSlot *s = &slotsM[slot];
+  // Keeps the interface registered until its callback returns
+  cMutexLock MutexLock(&ringMutexM);
+  cSatipPollerIf *poll = s->poller;
+  if (s->bufRing && (cqeP->flags & IORING_CQE_F_BUFFER)) {
+     unsigned int id = cqeP->flags >> IORING_CQE_BUFFER_SHIFT;
+     unsigned char *buffer = s->buffers + id * s->bufferSize;
+     if (poll && (cqeP->res > 0)) {
+        struct io_uring_recvmsg_out *out = io_uring_recvmsg_validate(buffer, cqeP->res, &s->msgh);
+        if (out && !(out->flags & MSG_TRUNC)) {
+           // Let the interface see the control data as if it was read by recvmsg()
+           struct msghdr msgh;
+           memset(&msgh, 0, sizeof(msgh));
+           msgh.msg_control = (unsigned char *)(out + 1) + s->msgh.msg_namelen;
+           msgh.msg_controllen = out->controllen;
+           poll->ProcessMessage(&msgh, (unsigned char *)io_uring_recvmsg_payload(out, &s->msgh),
+                                (int)io_uring_recvmsg_payload_length(out, cqeP->res, &s->msgh));
+           }
+        }
+     // Hand the buffer back to the kernel
+     io_uring_buf_ring_add(s->bufRing, buffer, s->bufferSize, id, io_uring_buf_ring_mask(s->bufferCount), 0);
+     io_uring_buf_ring_advance(s->bufRing, 1);
+     }
+  else if (poll && !s->bufRing && (cqeP->res > 0))
+     poll->Process();
+  // A multishot request ends when cancelled, on errors or when running out of buffers
+  if (!(cqeP->flags & IORING_CQE_F_MORE)) {
+     if (!s->poller) {
+        FreeRingBuffers(slot);
+        s->busy = false;
+        s->cancelPending = false;
+        return;
+        }
+     if (cqeP->res == -EINVAL && s->bufRing) {
+        info("Multishot receive not supported, polling %s instead [poller %d]", *(s->poller->ToString()), indexM);
+        FreeRingBuffers(slot);
+        }
+     else if (cqeP->res == -ENOBUFS)
+        debug6("%s Out of buffers for %s [poller %d]", __PRETTY_FUNCTION__, *(s->poller->ToString()), indexM);
+     if (!ArmRing(slot))
+        error("Cannot re-arm %s in io_uring [poller %d]", *(s->poller->ToString()), indexM);
+     }
+}
+
+void cSatipPollerThread::RingAction(void)
+{
+  if (!ArmWakeup())
+     error("Cannot add the wakeup into io_uring [poller %d]", indexM);
+  while (Running()) {
+        SubmitRing();
+        struct io_uring_cqe *cqe;
+        struct __kernel_timespec ts = { 0, eRingTimeoutMs * 1000000LL };
+        int ret = io_uring_wait_cqe_timeout(&ringM, &cqe, &ts);
+        if (ret < 0) {
+           if ((ret != -ETIME) && (ret != -EINTR)) {
+              char tmp[64];
+              error("io_uring_wait_cqe_timeout() failed: %s [poller %d]", strerror_r(-ret, tmp, sizeof(tmp)), indexM);
+              break;
+              }
+           continue;
+           }
+        // Handle all the pending completions at once
+        unsigned int head, count = 0;
+        io_uring_for_each_cqe(&ringM, head, cqe) {
+          ProcessRing(cqe);
+          count++;
+          }
+        io_uring_cq_advance(&ringM, count);
+        Report(count);
+        }
+}
+#endif
+
+// --- cSatipPoller -----------------------------------------------------------
+
 cSatipPoller *cSatipPoller::instanceS = NULL;
 
 cSatipPoller *cSatipPoller::GetInstance(void)
@@ -39,11 +436,15 @@ void cSatipPoller::Destroy(void)
 }
 
 cSatipPoller::cSatipPoller()
-: cThread("SATIP poller"),
-  mutexM(),
-  fdM(epoll_create(eMaxFileDescriptors))
+: mutexM(),
+  threadCountM(constrain(SatipConfig.GetPollerThreads(), 1U, (unsigned int)SATIP_MAX_POLLER_THREADS)),
+  nextThreadM(0)
 {
   debug1("%s", __PRETTY_FUNCTION__);
+  int cpus = SatipConfig.GetPollerAffinity() ? (int)sysconf(_SC_NPROCESSORS_ONLN) : 0;
+  for (unsigned int i = 0; i < ELEMENTS(threadsM); ++i)
+      threadsM[i] = (i < threadCountM) ? new cSatipPollerThread(i, (cpus > 0) ? (int)(i % cpus) : -1) : NULL;
+  info("Using %u poller thread%s", threadCountM, (threadCountM > 1) ? "s" : "");
 }
 
 cSatipPoller::~cSatipPoller()
@@ -51,72 +452,45 @@ cSatipPoller::~cSatipPoller()
   debug1("%s", __PRETTY_FUNCTION__);
   Deactivate();
   cMutexLock MutexLock(&mutexM);
-  close(fdM);
   // Free allocated memory
+  for (unsigned int i = 0; i < threadCountM; ++i)
+      DELETE_POINTER(threadsM[i]);
 }
 
 void cSatipPoller::Activate(void)
 {
-  // Start the thread
-  Start();
+  cMutexLock MutexLock(&mutexM);
+  // Start the threads
+  for (unsigned int i = 0; i < threadCountM; ++i)
+      threadsM[i]->Start();
 }
 
 void cSatipPoller::Deactivate(void)
 {
   debug1("%s", __PRETTY_FUNCTION__);
   cMutexLock MutexLock(&mutexM);
-  if (Running())
-     Cancel(3);
+  for (unsigned int i = 0; i < threadCountM; ++i)
+      threadsM[i]->Stop();
 }
 
-void cSatipPoller::Action(void)
+bool cSatipPoller::Register(cSatipPollerIf &pollerP, int keyP)
 {
-  debug1("%s Entering", __PRETTY_FUNCTION__);
-  struct epoll_event events[eMaxFileDescriptors];
-  uint64_t maxElapsed = 0;
-  // Increase priority
-  SetPriority(-1);
-  // Do the thread loop
-  while (Running()) {
-        int nfds = epoll_wait(fdM, events, eMaxFileDescriptors, -1);
-        ERROR_IF_FUNC((nfds == -1 && errno != EINTR), "epoll_wait() failed", break, ;);
-        for (int i = 0; i < nfds; ++i) {
-            cSatipPollerIf* poll = reinterpret_cast<cSatipPollerIf *>(events[i].data.ptr);
-            if (poll) {
-               uint64_t elapsed;
-               cTimeMs processing(0);
-               poll->Process();
-               elapsed = processing.Elapsed();
-               if (elapsed > maxElapsed) {
-                  maxElapsed = elapsed;
-                  debug1("%s Processing %s took %" PRIu64 " ms", __PRETTY_FUNCTION__, *(poll->ToString()), maxElapsed);
-                  }
-               }
-           }
-        }
-  debug1("%s Exiting", __PRETTY_FUNCTION__);
-}
-
-bool cSatipPoller::Register(cSatipPollerIf &pollerP)
-{
-  debug1("%s fd=%d", __PRETTY_FUNCTION__, pollerP.GetFd());
+  debug1("%s (, %d) fd=%d", __PRETTY_FUNCTION__, keyP, pollerP.GetFd());
   cMutexLock MutexLock(&mutexM);
-
-  struct epoll_event ev;
-  ev.events = EPOLLIN | EPOLLET;
-  ev.data.ptr = &pollerP;
-  ERROR_IF_RET(epoll_ctl(fdM, EPOLL_CTL_ADD, pollerP.GetFd(), &ev) == -1, "epoll_ctl(EPOLL_CTL_ADD) failed", return false);
-  debug1("%s Added interface fd=%d", __PRETTY_FUNCTION__, pollerP.GetFd());
-
-  return true;
+  unsigned int index = (keyP >= 0) ? (keyP % threadCountM) : (nextThreadM++ % threadCountM);
+  return threadsM[index]->Register(pollerP);
 }
 
 bool cSatipPoller::Unregister(cSatipPollerIf &pollerP)
 {
   debug1("%s fd=%d", __PRETTY_FUNCTION__, pollerP.GetFd());
   cMutexLock MutexLock(&mutexM);
-  ERROR_IF_RET((epoll_ctl(fdM, EPOLL_CTL_DEL, pollerP.GetFd(), NULL) == -1), "epoll_ctl(EPOLL_CTL_DEL) failed", return false);
-  debug1("%s Removed interface fd=%d", __PRETTY_FUNCTION__, pollerP.GetFd());
+  // Route the request into the owning thread
+  for (unsigned int i = 0; i < threadCountM; ++i) {
+      if (threadsM[i]->Has(pollerP))
+         return threadsM[i]->Unregister(pollerP);
+      }
+  debug1("%s Interface fd=%d not registered", __PRETTY_FUNCTION__, pollerP.GetFd());
 
-  return true;
+  return false;
 }
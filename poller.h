@@ -10,17 +10,90 @@
 
 #include <vdr/thread.h>
 #include <vdr/tools.h>
+#ifdef USE_LIBURING
+#include <liburing.h>
+#endif
 
+#include "common.h"
 #include "pollerif.h"
 
-class cSatipPoller : public cThread {
+class cSatipPollerThread : public cThread {
 private:
   enum {
-    eMaxFileDescriptors = SATIP_MAX_DEVICES * 2, // Data + Application
+    eMaxFileDescriptors = SATIP_MAX_DEVICES * 3, // Data + Application + Interleaved
+    eReportIntervalMs   = 10000, // in milliseconds
+#ifdef USE_LIBURING
+    eMaxRingSlots       = eMaxFileDescriptors * 2, // Slots are busy until the cancellation completes
+    eRingEntries        = 256,
+    eRingCancelData     = 0xFFFF,
+    eRingWakeupData     = 0xFFFE,
+    eRingControlSizeB   = 256,
+    eRingPoolSizeB      = 1024 * 1024, // per datagram interface
+    eRingMinBuffers     = 8,
+    eRingMaxBuffers     = 256,         // power of two
+    eRingTimeoutMs      = 500          // in milliseconds
+#endif
   };
+  int indexM;
+  int cpuM;
+  int fdM;
+  cVector<cSatipPollerIf *> pollersM;
+  unsigned int wakeupsM;
+  unsigned int eventsM;
+  cTimeMs reportM;
+#ifdef USE_LIBURING
+  struct ringSlot {
+    cSatipPollerIf *poller; // NULL once unregistered
+    bool busy;              // until the final completion
+    bool armPending;        // to be submitted by the ring thread
+    bool cancelPending;     // to be submitted by the ring thread
+    int fd;
+    struct msghdr msgh;     // template for the multishot receive
+    struct io_uring_buf_ring *bufRing;
+    unsigned char *buffers;
+    unsigned int bufferSize;
+    unsigned int bufferCount;
+  };
+  cMutex ringMutexM;
+  struct io_uring ringM;
+  bool useRingM;
+  int wakeupFdM;
+  ringSlot slotsM[eMaxRingSlots];
+  bool SetupRingBuffers(int slotP, unsigned int sizeP);
+  void FreeRingBuffers(int slotP);
+  struct io_uring_sqe *GetRingSqe(void);
+  bool ArmRing(int slotP);
+  bool ArmWakeup(void);
+  void WakeupRing(void);
+  void SubmitRing(void);
+  void ProcessRing(struct io_uring_cqe *cqeP);
+  void RingAction(void);
+#endif
+  void Report(unsigned int eventsP);
+  // to prevent copy constructor and assignment
+  cSatipPollerThread(const cSatipPollerThread&);
+  cSatipPollerThread& operator=(const cSatipPollerThread&);
+
+protected:
+  virtual void Action(void);
+
+public:
+  cSatipPollerThread(int indexP, int cpuP);
+  virtual ~cSatipPollerThread();
+  void Stop(void);
+  int Count(void) const { return pollersM.Size(); }
+  bool Has(cSatipPollerIf &pollerP) const { return (pollersM.IndexOf(&pollerP) >= 0); }
+  bool Register(cSatipPollerIf &pollerP);
+  bool Unregister(cSatipPollerIf &pollerP);
+};
+
+class cSatipPoller {
+private:
   static cSatipPoller *instanceS;
   cMutex mutexM;
-  int fdM;
+  cSatipPollerThread *threadsM[SATIP_MAX_POLLER_THREADS];
+  unsigned int threadCountM;
+  unsigned int nextThreadM;
   void Activate(void);
   void Deactivate(void);
   // constructor
@@ -29,15 +102,13 @@ private:
   cSatipPoller(const cSatipPoller&);
   cSatipPoller& operator=(const cSatipPoller&);
 
-protected:
-  virtual void Action(void);
-
 public:
   static cSatipPoller *GetInstance(void);
   static bool Initialize(void);
   static void Destroy(void);
   virtual ~cSatipPoller();
-  bool Register(cSatipPollerIf &pollerP);
+  // A non-negative key pins the interface into a certain thread, otherwise the threads are used in turns
+  bool Register(cSatipPollerIf &pollerP, int keyP = -1);
   bool Unregister(cSatipPollerIf &pollerP);
 };
 
@@ -8,6 +8,8 @@
 #ifndef __SATIP_POLLERIF_H
 #define __SATIP_POLLERIF_H
 
+#include <sys/socket.h>
+
 class cSatipPollerIf {
 public:
   cSatipPollerIf() {}
@@ -15,6 +17,10 @@ public:
   virtual int GetFd(void) = 0;
   virtual void Process(void) = 0;
   virtual void Process(unsigned char *dataP, int lengthP) = 0;
+  // A non-zero datagram size lets a completion based poller receive the
+  // datagrams by itself and hand them over along with their control data
+  virtual unsigned int GetDatagramSize(void) { return 0; }
+  virtual void ProcessMessage(struct msghdr *msghP, unsigned char *dataP, int lengthP) { Process(dataP, lengthP); }
   virtual cString ToString(void) const = 0;
 
 private:
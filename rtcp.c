@@ -102,6 +102,18 @@ void cSatipRtcp::Process(unsigned char *dataP, int lengthP)
      }
 }
 
+unsigned int cSatipRtcp::GetDatagramSize(void)
+{
+  return bufferLenM;
+}
+
+void cSatipRtcp::ProcessMessage(struct msghdr *msghP, unsigned char *dataP, int lengthP)
+{
+  debug16("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
+  if (ProcessControl(msghP))
+     Process(dataP, lengthP);
+}
+
 cString cSatipRtcp::ToString(void) const
 {
   return cString::sprintf("RTCP [device %d]", tunerM.GetId());
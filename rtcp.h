@@ -31,6 +31,8 @@ public:
   virtual int GetFd(void);
   virtual void Process(void);
   virtual void Process(unsigned char *dataP, int lengthP);
+  virtual unsigned int GetDatagramSize(void);
+  virtual void ProcessMessage(struct msghdr *msghP, unsigned char *dataP, int lengthP);
   virtual cString ToString(void) const;
 };
 
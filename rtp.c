@@ -16,20 +16,58 @@
 cSatipRtp::cSatipRtp(cSatipTunerIf &tunerP)
 : cSatipSocket(SatipConfig.GetRtpRcvBufSize()),
   tunerM(tunerP),
-  bufferLenM(eRtpPacketReadCount * eMaxUdpPacketSizeB),
+  bufferLenM(max((int)eRtpPacketReadMax * eMaxUdpPacketSizeB, (int)eRtpGroReadCount * eMaxGroPacketSizeB)),
   bufferM(MALLOC(unsigned char, bufferLenM)),
+  batchM(eRtpPacketReadMin * 4),
+  idleBatchesM(0),
+  zeroCopyM(SatipConfig.GetZeroCopy()),
   lastErrorReportM(0),
   packetErrorsM(0),
-  sequenceNumberM(-1)
+  sequenceNumberM(-1),
+  reorderDepthM(0),
+  reorderTimeoutM(SatipConfig.GetRtpReorderTimeout()),
+  reorderBufferM(NULL),
+  reorderCountM(0),
+  reorderMutexM(),
+  expectedM(-1),
+  lostM(0),
+  lateM(0),
+  duplicateM(0),
+  reorderedM(0),
+  arrivalM(0)
 {
   debug1("%s () [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
   if (!bufferM)
      error("Cannot create RTP buffer! [device %d]", tunerM.GetId());
+  memset(headersM, 0, sizeof(headersM));
+  memset(reorderLengthM, 0, sizeof(reorderLengthM));
+  memset(reorderArrivalM, 0, sizeof(reorderArrivalM));
+  memset(reorderStampM, 0, sizeof(reorderStampM));
+  memset(lostHistoryM, 0, sizeof(lostHistoryM));
+  SetReadTimeout(SatipConfig.GetRtpBatchTimeout());
+  SetGro(SatipConfig.GetGro());
+  if (SatipConfig.GetRtpReorderDepth() > 1) {
+     // The sequence numbers wrap at 16 bits, so a power of two keeps the slots continuous
+     reorderDepthM = 2;
+     while (reorderDepthM < min(SatipConfig.GetRtpReorderDepth(), (unsigned int)eReorderMaxDepth))
+           reorderDepthM <<= 1;
+     reorderBufferM = MALLOC(unsigned char, reorderDepthM * eMaxUdpPacketSizeB);
+     if (!reorderBufferM) {
+        error("Cannot create RTP reorder buffer! [device %d]", tunerM.GetId());
+        reorderDepthM = 0;
+        }
+     // The packets must be buffered in the order of arrival
+     else if (zeroCopyM) {
+        info("Disabling zero-copy mode due to RTP reordering [device %d]", tunerM.GetId());
+        zeroCopyM = false;
+        }
+     }
 }
 
 cSatipRtp::~cSatipRtp()
 {
   debug1("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
+  FREE_POINTER(reorderBufferM);
   FREE_POINTER(bufferM);
 }
 
@@ -50,51 +88,106 @@ void cSatipRtp::Close(void)
      packetErrorsM = 0;
      lastErrorReportM = time(NULL);
      }
+  // Hand over anything left in the reorder window before starting over
+  cMutexLock MutexLock(&reorderMutexM);
+  if (reorderDepthM)
+     Flush();
+  memset(reorderLengthM, 0, sizeof(reorderLengthM));
+  memset(lostHistoryM, 0, sizeof(lostHistoryM));
+  reorderCountM = 0;
+  expectedM = -1;
+}
+
+bool cSatipRtp::ReleaseExpired(void)
+{
+  // The window is also released here, as a stalled stream won't push it forward
+  if (!reorderDepthM)
+     return false;
+  cMutexLock MutexLock(&reorderMutexM);
+  if (reorderCountM > 0)
+     Release(cTimeMs::Now());
+  return (reorderCountM > 0);
+}
+
+cString cSatipRtp::GetInformation(void)
+{
+  unsigned int lost, late, duplicate, reordered;
+  GetSequenceStatistics(lost, late, duplicate, reordered);
+  return cString::sprintf("lost=%u late=%u duplicate=%u reordered=%u", lost, late, duplicate, reordered);
+}
+
+void cSatipRtp::GetSequenceStatistics(unsigned int &lostP, unsigned int &lateP, unsigned int &duplicateP, unsigned int &reorderedP)
+{
+  // Read by the exporter while the poller thread is updating them
+  lostP = __atomic_load_n(&lostM, __ATOMIC_RELAXED);
+  lateP = __atomic_load_n(&lateM, __ATOMIC_RELAXED);
+  duplicateP = __atomic_load_n(&duplicateM, __ATOMIC_RELAXED);
+  reorderedP = __atomic_load_n(&reorderedM, __ATOMIC_RELAXED);
 }
 
 int cSatipRtp::GetHeaderLength(unsigned char *bufferP, unsigned int lengthP)
 {
-  debug16("%s (, %d) [device %d]", __PRETTY_FUNCTION__, lengthP, tunerM.GetId());
+  return GetHeaderLength(bufferP, bufferP + eRtpHeaderSizeB, lengthP);
+}
+
+int cSatipRtp::GetHeaderLength(unsigned char *headerP, unsigned char *payloadP, unsigned int lengthP)
+{
+  debug16("%s (, , %d) [device %d]", __PRETTY_FUNCTION__, lengthP, tunerM.GetId());
   unsigned int headerlen = 0;
+  // The fixed header is in headerP and anything beyond it in payloadP
+#define RTP_BYTE(n) (((n) < eRtpHeaderSizeB) ? headerP[(n)] : payloadP[(n) - eRtpHeaderSizeB])
 
   if (lengthP > 0) {
-     if (bufferP[0] == TS_SYNC_BYTE)
+     if (headerP[0] == TS_SYNC_BYTE)
         return headerlen;
      else if (lengthP > 3) {
         // http://tools.ietf.org/html/rfc3550
         // http://tools.ietf.org/html/rfc2250
         // Version
-        unsigned int v = (bufferP[0] >> 6) & 0x03;
+        unsigned int v = (headerP[0] >> 6) & 0x03;
         // Extension bit
-        unsigned int x = (bufferP[0] >> 4) & 0x01;
+        unsigned int x = (headerP[0] >> 4) & 0x01;
         // CSCR count
-        unsigned int cc = bufferP[0] & 0x0F;
+        unsigned int cc = headerP[0] & 0x0F;
         // Payload type: MPEG2 TS = 33
-        unsigned int pt = bufferP[1] & 0x7F;
+        unsigned int pt = headerP[1] & 0x7F;
         if (pt != 33)
            debug7("%s (%d) Received invalid RTP payload type %d - v=%d [device %d]",
                     __PRETTY_FUNCTION__, lengthP, pt, v, tunerM.GetId());
         // Sequence number
-        int seq = ((bufferP[2] & 0xFF) << 8) | (bufferP[3] & 0xFF);
-        if ((((sequenceNumberM + 1) % 0xFFFF) == 0) && (seq == 0xFFFF))
-           sequenceNumberM = -1;
-        else if ((sequenceNumberM >= 0) && (((sequenceNumberM + 1) % 0xFFFF) != seq)) {
+        int seq = ((headerP[2] & 0xFF) << 8) | (headerP[3] & 0xFF);
+        // The reorder window does its own accounting for the accepted packets only
+        if (!reorderDepthM && (sequenceNumberM >= 0) && (((sequenceNumberM + 1) & 0xFFFF) != seq)) {
+           // Signed distance from the expected sequence number over the 16-bit wraparound
+           int gap = (int16_t)((seq - sequenceNumberM - 1) & 0xFFFF);
+           if (gap > 0)
+              __atomic_fetch_add(&lostM, gap, __ATOMIC_RELAXED);
+           else if (gap == -1)
+              __atomic_fetch_add(&duplicateM, 1, __ATOMIC_RELAXED);
+           else {
+              // Passed through as is, but it was counted as lost already
+              if (__atomic_load_n(&lostM, __ATOMIC_RELAXED))
+                 __atomic_fetch_sub(&lostM, 1, __ATOMIC_RELAXED);
+              __atomic_fetch_add(&lateM, 1, __ATOMIC_RELAXED);
+              }
            packetErrorsM++;
            if (time(NULL) - lastErrorReportM > eReportIntervalS) {
               info("Detected %d RTP packet error%s [device %d]", packetErrorsM, packetErrorsM == 1 ? "": "s", tunerM.GetId());
               packetErrorsM = 0;
               lastErrorReportM = time(NULL);
               }
-           sequenceNumberM = seq;
+           // Keep following the newest packet
+           if (gap > 0)
+              sequenceNumberM = seq;
            }
-        else
+        else if (!reorderDepthM)
            sequenceNumberM = seq;
         // Header length
         headerlen = (3 + cc) * (unsigned int)sizeof(uint32_t);
         // Check if extension
         if (x) {
            // Extension header length
-           unsigned int ehl = (((bufferP[headerlen + 2] & 0xFF) << 8) | (bufferP[headerlen + 3] & 0xFF));
+           unsigned int ehl = (((RTP_BYTE(headerlen + 2) & 0xFF) << 8) | (RTP_BYTE(headerlen + 3) & 0xFF));
            // Update header length
            headerlen += (ehl + 1) * (unsigned int)sizeof(uint32_t);
            }
@@ -104,38 +197,272 @@ int cSatipRtp::GetHeaderLength(unsigned char *bufferP, unsigned int lengthP)
            headerlen = -1;
            }
         // Check that rtp is version 2 and payload contains multiple of TS packet data
-        else if ((v != 2) || (((lengthP - headerlen) % TS_SIZE) != 0) || (bufferP[headerlen] != TS_SYNC_BYTE)) {
+        else if ((v != 2) || (((lengthP - headerlen) % TS_SIZE) != 0) || (RTP_BYTE(headerlen) != TS_SYNC_BYTE)) {
            debug7("%s (%d) Received incorrect RTP packet #%d v=%d len=%d sync=0x%02X [device %d]", __PRETTY_FUNCTION__,
-                   lengthP, seq, v, headerlen, bufferP[headerlen], tunerM.GetId());
+                   lengthP, seq, v, headerlen, RTP_BYTE(headerlen), tunerM.GetId());
            headerlen = -1;
            }
-        else
+        else {
            debug7("%s (%d) Received RTP packet #%d v=%d len=%d sync=0x%02X [device %d]", __PRETTY_FUNCTION__,
-                   lengthP, seq, v, headerlen, bufferP[headerlen], tunerM.GetId());
+                   lengthP, seq, v, headerlen, RTP_BYTE(headerlen), tunerM.GetId());
+           if (reorderDepthM)
+              sequenceNumberM = seq;
+           }
         }
      }
 
+#undef RTP_BYTE
+
   return headerlen;
 }
 
+int cSatipRtp::ReadZeroCopy(unsigned int &requestP)
+{
+  debug16("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
+  int length = 0;
+  unsigned char *buffer = tunerM.GetVideoBuffer(length);
+  requestP = buffer ? min(length / eMaxTsPayloadSizeB, (int)batchM) : 0;
+  if (requestP <= 0)
+     return -1;
+
+  // The kernel scatters RTP headers into a side buffer and TS payloads directly into the TS buffer
+  unsigned int lenMsg[eRtpPacketReadMax];
+  uint64_t arrivals[eRtpPacketReadMax];
+  unsigned char *w = buffer;
+  int count = ReadMulti(headersM, eRtpHeaderSizeB, buffer, lenMsg, requestP, eMaxTsPayloadSizeB, arrivals);
+  int fallback = count;
+  for (int i = 0; i < count; ++i) {
+      unsigned char *p = &buffer[i * eMaxTsPayloadSizeB];
+      // Skip the datagrams of other multicast groups
+      if (lenMsg[i] == 0)
+         continue;
+      bool oversized = (lenMsg[i] > eRtpHeaderSizeB + eMaxTsPayloadSizeB);
+      int headerlen = (!oversized && (lenMsg[i] > eRtpHeaderSizeB)) ? GetHeaderLength(&headersM[i * eRtpHeaderSizeB], p, lenMsg[i]) : -1;
+      if (oversized || (headerlen == 0)) {
+         // Oversized datagrams and raw TS streams can't be scattered
+         info("Disabling zero-copy mode due to %s [device %d]", oversized ? "oversized RTP packet" : "non-RTP stream", tunerM.GetId());
+         zeroCopyM = false;
+         fallback = i;
+         break;
+         }
+      else if ((headerlen >= eRtpHeaderSizeB) && (headerlen < (int)lenMsg[i])) {
+         // Skip any CSRC identifiers or header extension and close the gaps left by short packets
+         int len = lenMsg[i] - headerlen;
+         p += headerlen - eRtpHeaderSizeB;
+         if (p != w)
+            memmove(w, p, len);
+         tunerM.AnalyzeVideoData(w, len, arrivals[i]);
+         w += len;
+         }
+      }
+  if (w > buffer)
+     tunerM.CommitVideoData(buffer, (int)(w - buffer));
+
+  // Reassemble the rest of the batch into the copying buffer first, as the delivery reuses the free TS buffer space
+  for (int i = fallback; i < count; ++i) {
+      unsigned char *p = &bufferM[i * eMaxUdpPacketSizeB];
+      // The tail of a truncated datagram is lost already
+      if (lenMsg[i] > eRtpHeaderSizeB + eMaxTsPayloadSizeB)
+         lenMsg[i] = 0;
+      memcpy(p, &headersM[i * eRtpHeaderSizeB], min(lenMsg[i], (unsigned int)eRtpHeaderSizeB));
+      if (lenMsg[i] > eRtpHeaderSizeB)
+         memcpy(p + eRtpHeaderSizeB, &buffer[i * eMaxTsPayloadSizeB], lenMsg[i] - eRtpHeaderSizeB);
+      }
+  // and deliver it via the copying path, starting with the datagram that disabled zero-copy
+  for (int i = fallback; i < count; ++i) {
+      unsigned char *p = &bufferM[i * eMaxUdpPacketSizeB];
+      int headerlen = GetHeaderLength(p, lenMsg[i]);
+      if ((headerlen >= 0) && (headerlen < (int)lenMsg[i]))
+         Deliver(p + headerlen, lenMsg[i] - headerlen, arrivals[i]);
+      }
+
+  return count;
+}
+
+void cSatipRtp::AdaptBatch(int readsP, int countP)
+{
+  unsigned int batch = batchM;
+  // Grow whenever a batch came back full and shrink only after being mostly idle for a while
+  if (readsP > 1) {
+     idleBatchesM = 0;
+     if (batchM < eRtpPacketReadMax)
+        batchM = min(batchM * 2, (unsigned int)eRtpPacketReadMax);
+     }
+  else if (countP < (int)(batchM / 4)) {
+     if ((++idleBatchesM >= eRtpIdleBatchLimit) && (batchM > eRtpPacketReadMin)) {
+        batchM /= 2;
+        idleBatchesM = 0;
+        }
+     }
+  else
+     idleBatchesM = 0;
+  if (batchM != batch)
+     debug6("%s Batch size changed from %u to %u [device %d]", __PRETTY_FUNCTION__, batch, batchM, tunerM.GetId());
+}
+
+void cSatipRtp::Deliver(unsigned char *dataP, int lengthP, uint64_t arrivalP)
+{
+  if (reorderDepthM) {
+     cMutexLock MutexLock(&reorderMutexM);
+     Reorder(dataP, lengthP, arrivalP);
+     }
+  else
+     tunerM.ProcessVideoData(dataP, lengthP, arrivalP);
+}
+
+void cSatipRtp::Reorder(unsigned char *dataP, int lengthP, uint64_t arrivalP)
+{
+  debug16("%s (, %d) seq=%d expected=%d [device %d]", __PRETTY_FUNCTION__, lengthP, sequenceNumberM, expectedM, tunerM.GetId());
+  uint64_t now = cTimeMs::Now();
+  int seq = sequenceNumberM;
+  if (expectedM < 0)
+     expectedM = seq;
+  // Signed distance from the next packet to be released over the 16-bit wraparound
+  int distance = (int16_t)((seq - expectedM) & 0xFFFF);
+  if ((distance >= eReorderHistorySize) || (distance <= -eReorderHistorySize)) {
+     // The stream has been restarted
+     debug7("%s Resyncing from %d to %d [device %d]", __PRETTY_FUNCTION__, expectedM, seq, tunerM.GetId());
+     Flush();
+     expectedM = seq;
+     distance = 0;
+     }
+  else if (distance < 0) {
+     // Too late as the window has passed it already
+     uint32_t bit = 1U << (seq & 31);
+     uint32_t &lost = lostHistoryM[(seq & (eReorderHistorySize - 1)) >> 5];
+     if (lost & bit) {
+        lost &= ~bit;
+        if (__atomic_load_n(&lostM, __ATOMIC_RELAXED))
+           __atomic_fetch_sub(&lostM, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&lateM, 1, __ATOMIC_RELAXED);
+        }
+     else
+        __atomic_fetch_add(&duplicateM, 1, __ATOMIC_RELAXED);
+     return;
+     }
+  // Make room for the packet by releasing or giving up the oldest ones
+  while (distance >= (int)reorderDepthM) {
+        Advance();
+        distance--;
+        }
+  unsigned int slot = seq & (reorderDepthM - 1);
+  if (reorderLengthM[slot]) {
+     __atomic_fetch_add(&duplicateM, 1, __ATOMIC_RELAXED);
+     return;
+     }
+  if ((distance == 0) && reorderCountM)
+     __atomic_fetch_add(&reorderedM, 1, __ATOMIC_RELAXED);
+  memcpy(reorderBufferM + slot * eMaxUdpPacketSizeB, dataP, min(lengthP, (int)eMaxUdpPacketSizeB));
+  reorderLengthM[slot] = min(lengthP, (int)eMaxUdpPacketSizeB);
+  reorderArrivalM[slot] = now;
+  reorderStampM[slot] = arrivalP;
+  reorderCountM++;
+  Release(now);
+}
+
+void cSatipRtp::Release(uint64_t nowP)
+{
+  while (reorderCountM > 0) {
+        if (!reorderLengthM[expectedM & (reorderDepthM - 1)]) {
+           // Wait for the missing packet until the oldest buffered one gets too old
+           uint64_t oldest = nowP;
+           for (unsigned int i = 1; i < reorderDepthM; ++i) {
+               unsigned int slot = (expectedM + i) & (reorderDepthM - 1);
+               if (reorderLengthM[slot] && (reorderArrivalM[slot] < oldest))
+                  oldest = reorderArrivalM[slot];
+               }
+           if (nowP - oldest < reorderTimeoutM)
+              break;
+           }
+        Advance();
+        }
+}
+
+void cSatipRtp::Advance(void)
+{
+  // Release the next packet or give it up as lost
+  unsigned int slot = expectedM & (reorderDepthM - 1);
+  uint32_t bit = 1U << (expectedM & 31);
+  uint32_t &lost = lostHistoryM[(expectedM & (eReorderHistorySize - 1)) >> 5];
+  if (reorderLengthM[slot]) {
+     tunerM.ProcessVideoData(reorderBufferM + slot * eMaxUdpPacketSizeB, reorderLengthM[slot], reorderStampM[slot]);
+     reorderLengthM[slot] = 0;
+     reorderCountM--;
+     lost &= ~bit;
+     }
+  else {
+     debug7("%s Lost packet #%d [device %d]", __PRETTY_FUNCTION__, expectedM, tunerM.GetId());
+     __atomic_fetch_add(&lostM, 1, __ATOMIC_RELAXED);
+     lost |= bit;
+     }
+  expectedM = (expectedM + 1) & 0xFFFF;
+}
+
+void cSatipRtp::Flush(void)
+{
+  // Release everything in order without any loss accounting
+  for (unsigned int i = 0; (i < reorderDepthM) && (reorderCountM > 0); ++i) {
+      unsigned int slot = (expectedM + i) & (reorderDepthM - 1);
+      if (reorderLengthM[slot]) {
+         tunerM.ProcessVideoData(reorderBufferM + slot * eMaxUdpPacketSizeB, reorderLengthM[slot], reorderStampM[slot]);
+         reorderLengthM[slot] = 0;
+         reorderCountM--;
+         }
+      }
+  memset(lostHistoryM, 0, sizeof(lostHistoryM));
+}
+
 void cSatipRtp::Process(void)
 {
   debug16("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
   if (bufferM) {
-     unsigned int lenMsg[eRtpPacketReadCount];
+     unsigned int lenMsg[eRtpPacketReadMax];
+     unsigned int segMsg[eRtpGroReadCount];
+     uint64_t arrivals[eRtpPacketReadMax];
      uint64_t elapsed;
-     int count = 0;
+     int count = 0, datagrams = 0, total = 0, reads = 0;
+     unsigned int request = batchM;
      cTimeMs processing(0);
 
      do {
-       count = ReadMulti(bufferM, lenMsg, eRtpPacketReadCount, eMaxUdpPacketSizeB);
-       for (int i = 0; i < count; ++i) {
-           unsigned char *p = &bufferM[i * eMaxUdpPacketSizeB];
-           int headerlen = GetHeaderLength(p, lenMsg[i]);
-           if ((headerlen >= 0) && (headerlen < (int)lenMsg[i]))
-              tunerM.ProcessVideoData(p + headerlen, lenMsg[i] - headerlen);
-           }
-       } while (count >= eRtpPacketReadCount);
+       if (HasGro()) {
+          // Split the coalesced datagrams by the segment size, the last segment may be shorter
+          request = eRtpGroReadCount;
+          count = ReadMulti(bufferM, lenMsg, request, eMaxGroPacketSizeB, segMsg, arrivals);
+          datagrams = 0;
+          for (int i = 0; i < count; ++i) {
+              unsigned int segment = segMsg[i] ? segMsg[i] : lenMsg[i];
+              for (unsigned int offset = 0; offset < lenMsg[i]; offset += segment) {
+                  unsigned char *p = &bufferM[i * eMaxGroPacketSizeB + offset];
+                  int len = min(segment, lenMsg[i] - offset);
+                  int headerlen = GetHeaderLength(p, len);
+                  if ((headerlen >= 0) && (headerlen < len))
+                     Deliver(p + headerlen, len - headerlen, arrivals[i]);
+                  datagrams++;
+                  }
+              }
+          }
+       // Fall back to the copying path whenever there's no room for zero-copy
+       else if (!zeroCopyM || ((count = ReadZeroCopy(request)) < 0)) {
+          request = batchM;
+          count = ReadMulti(bufferM, lenMsg, request, eMaxUdpPacketSizeB, NULL, arrivals);
+          datagrams = count;
+          for (int i = 0; i < count; ++i) {
+              unsigned char *p = &bufferM[i * eMaxUdpPacketSizeB];
+              int headerlen = GetHeaderLength(p, lenMsg[i]);
+              if ((headerlen >= 0) && (headerlen < (int)lenMsg[i]))
+                 Deliver(p + headerlen, lenMsg[i] - headerlen, arrivals[i]);
+              }
+          }
+       else
+          datagrams = count;
+       reads++;
+       // Adapt the batch by the real datagram count, a coalesced read may carry dozens of them
+       if (datagrams > 0)
+          total += datagrams;
+       } while (count >= (int)request);
+     AdaptBatch(reads, total);
+     ReleaseExpired();
 
      elapsed = processing.Elapsed();
      if (elapsed > 1)
@@ -151,7 +478,8 @@ void cSatipRtp::Process(unsigned char *dataP, int lengthP)
      cTimeMs processing(0);
      int headerlen = GetHeaderLength(dataP, lengthP);
      if ((headerlen >= 0) && (headerlen < lengthP))
-        tunerM.ProcessVideoData(dataP + headerlen, lengthP - headerlen);
+        Deliver(dataP + headerlen, lengthP - headerlen, arrivalM);
+     ReleaseExpired();
 
      elapsed = processing.Elapsed();
      if (elapsed > 1)
@@ -159,6 +487,25 @@ void cSatipRtp::Process(unsigned char *dataP, int lengthP)
      }
 }
 
+unsigned int cSatipRtp::GetDatagramSize(void)
+{
+  return HasGro() ? eMaxGroPacketSizeB : eMaxUdpPacketSizeB;
+}
+
+void cSatipRtp::ProcessMessage(struct msghdr *msghP, unsigned char *dataP, int lengthP)
+{
+  debug16("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
+  unsigned int segment = 0;
+  if (dataP && (lengthP > 0) && ProcessControl(msghP, &segment, &arrivalM)) {
+     // Split any coalesced datagrams by the segment size
+     if (!segment)
+        segment = lengthP;
+     for (int offset = 0; offset < lengthP; offset += segment)
+         Process(dataP + offset, min((int)segment, lengthP - offset));
+     }
+  arrivalM = 0;
+}
+
 cString cSatipRtp::ToString(void) const
 {
   return cString::sprintf("RTP [device %d]", tunerM.GetId());
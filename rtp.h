@@ -8,6 +8,8 @@
 #ifndef __SATIP_RTP_H_
 #define __SATIP_RTP_H_
 
+#include <vdr/thread.h>
+
 #include "socket.h"
 #include "tunerif.h"
 #include "pollerif.h"
@@ -15,28 +17,69 @@
 class cSatipRtp : public cSatipSocket, public cSatipPollerIf {
 private:
   enum {
-    eRtpPacketReadCount = 50,
-    eMaxUdpPacketSizeB  = TS_SIZE * 7 + 12,
+    eRtpPacketReadMin   = 4,
+    eRtpPacketReadMax   = 128,
+    eRtpIdleBatchLimit  = 8,
+    eRtpHeaderSizeB     = 12,
+    eMaxTsPayloadSizeB  = TS_SIZE * 7,
+    eMaxUdpPacketSizeB  = 2048, // room for CSRCs, header extensions and longer payloads
+    eRtpGroReadCount    = 4,
+    eMaxGroPacketSizeB  = 65536,
+    eReorderMaxDepth    = 256,
+    eReorderHistorySize = 1024, // power of two
     eReportIntervalS    = 300 // in seconds
   };
   cSatipTunerIf &tunerM;
   unsigned int bufferLenM;
   unsigned char *bufferM;
+  unsigned char headersM[eRtpPacketReadMax * eRtpHeaderSizeB];
+  unsigned int batchM;
+  unsigned int idleBatchesM;
+  bool zeroCopyM;
   time_t lastErrorReportM;
   int packetErrorsM;
   int sequenceNumberM;
+  // Reorder window indexed by the sequence number
+  unsigned int reorderDepthM;
+  unsigned int reorderTimeoutM;
+  unsigned char *reorderBufferM;
+  int reorderLengthM[eReorderMaxDepth];
+  uint64_t reorderArrivalM[eReorderMaxDepth];
+  uint64_t reorderStampM[eReorderMaxDepth];
+  int reorderCountM;
+  cMutex reorderMutexM;
+  int expectedM;
+  uint32_t lostHistoryM[eReorderHistorySize / 32];
+  unsigned int lostM;
+  unsigned int lateM;
+  unsigned int duplicateM;
+  unsigned int reorderedM;
+  uint64_t arrivalM;
   int GetHeaderLength(unsigned char *bufferP, unsigned int lengthP);
+  int GetHeaderLength(unsigned char *headerP, unsigned char *payloadP, unsigned int lengthP);
+  int ReadZeroCopy(unsigned int &requestP);
+  void AdaptBatch(int readsP, int countP);
+  void Deliver(unsigned char *dataP, int lengthP, uint64_t arrivalP);
+  void Reorder(unsigned char *dataP, int lengthP, uint64_t arrivalP);
+  void Release(uint64_t nowP);
+  void Advance(void);
+  void Flush(void);
 
 public:
   explicit cSatipRtp(cSatipTunerIf &tunerP);
   virtual ~cSatipRtp();
   virtual void Close(void);
+  cString GetInformation(void);
+  bool ReleaseExpired(void);
+  void GetSequenceStatistics(unsigned int &lostP, unsigned int &lateP, unsigned int &duplicateP, unsigned int &reorderedP);
 
   // for internal poller interface
 public:
   virtual int GetFd(void);
   virtual void Process(void);
   virtual void Process(unsigned char *dataP, int lengthP);
+  virtual unsigned int GetDatagramSize(void);
+  virtual void ProcessMessage(struct msghdr *msghP, unsigned char *dataP, int lengthP);
   virtual cString ToString(void) const;
 };
 
@@ -11,6 +11,7 @@
 #include "config.h"
 #include "common.h"
 #include "log.h"
+#include "poller.h"
 #include "rtsp.h"
 
 cSatipRtsp::cSatipRtsp(cSatipTunerIf &tunerP)
@@ -18,13 +19,20 @@ cSatipRtsp::cSatipRtsp(cSatipTunerIf &tunerP)
   headerBufferM(),
   dataBufferM(),
   handleM(NULL),
+  multiM(curl_multi_init()),
+  socketM(-1),
+  abortM(0),
   headerListM(NULL),
   errorNoMoreM(""),
   errorOutOfRangeM(""),
   errorCheckSyntaxM(""),
   modeM(cSatipConfig::eTransportModeUnicast),
   interleavedRtpIdM(0),
-  interleavedRtcpIdM(1)
+  interleavedRtcpIdM(1),
+  interleaveM(tunerP),
+  requestsM(0),
+  requestFailuresM(0),
+  requestTimeMsM(0)
 {
   debug1("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
   Create();
@@ -34,6 +42,10 @@ cSatipRtsp::~cSatipRtsp()
 {
   debug1("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
   Destroy();
+  if (multiM) {
+     curl_multi_cleanup(multiM);
+     multiM = NULL;
+     }
 }
 
 size_t cSatipRtsp::HeaderCallback(char *ptrP, size_t sizeP, size_t nmembP, void *dataP)
@@ -66,11 +78,12 @@ size_t cSatipRtsp::InterleaveCallback(char *ptrP, size_t sizeP, size_t nmembP, v
   size_t len = sizeP * nmembP;
   debug16("%s len=%zu", __PRETTY_FUNCTION__, len);
 
-  if (obj && ptrP && len > 0) {
+  // Only the frames read during a request end up here, the rest is read by the interleave reader
+  if (obj && ptrP && len > 4) {
      char tag = ptrP[0] & 0xFF;
      if (tag == '$') {
         int count = ((ptrP[2] & 0xFF) << 8) | (ptrP[3] & 0xFF);
-        if (count > 0) {
+        if ((count > 0) && (count <= (int)len - 4)) {
            unsigned int channel = ptrP[1] & 0xFF;
            u_char *data = (u_char *)&ptrP[4];
            if (channel == obj->interleavedRtpIdM)
@@ -113,6 +126,24 @@ int cSatipRtsp::DebugCallback(CURL *handleP, curl_infotype typeP, char *dataP, s
   return 0;
 }
 
+void cSatipRtsp::GetRequestStatistics(unsigned long &requestsP, unsigned long &failuresP, unsigned long &timeMsP)
+{
+  requestsP = __atomic_load_n(&requestsM, __ATOMIC_RELAXED);
+  failuresP = __atomic_load_n(&requestFailuresM, __ATOMIC_RELAXED);
+  timeMsP = __atomic_load_n(&requestTimeMsM, __ATOMIC_RELAXED);
+}
+
+bool cSatipRtsp::IsRtpOverTcp(void) const
+{
+  return (modeM == cSatipConfig::eTransportModeRtpOverTcp);
+}
+
+bool cSatipRtsp::IsReceivePolled(void) const
+{
+  // Without the interleave reader, the interleaved data is read only during the requests
+  return (IsRtpOverTcp() && !interleaveM.IsOpen());
+}
+
 cString cSatipRtsp::GetActiveMode(void)
 {
   switch (modeM) {
@@ -131,8 +162,9 @@ cString cSatipRtsp::GetActiveMode(void)
 cString cSatipRtsp::RtspUnescapeString(const char *strP)
 {
   debug1("%s (%s) [device %d]", __PRETTY_FUNCTION__, strP, tunerM.GetId());
-  if (handleM) {
-     char *p = curl_easy_unescape(handleM, strP, 0, NULL);
+  // No handle is passed, as this is called outside the tuner thread
+  char *p = curl_easy_unescape(NULL, strP, 0, NULL);
+  if (p) {
      cString s = p;
      curl_free(p);
 
@@ -172,6 +204,9 @@ void cSatipRtsp::Create(void)
 void cSatipRtsp::Destroy(void)
 {
   debug1("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
+  // The socket is closed along with the handle
+  CloseInterleave();
+  socketM = -1;
   if (handleM) {
      // Cleanup curl stuff
      if (headerListM) {
@@ -190,6 +225,117 @@ void cSatipRtsp::Reset(void)
   Create();
 }
 
+void cSatipRtsp::Abort(void)
+{
+  debug1("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
+  // May be called from any thread to cancel the request in progress
+  __atomic_store_n(&abortM, 1, __ATOMIC_RELEASE);
+#if LIBCURL_VERSION_NUM >= 0x074400
+  if (multiM)
+     curl_multi_wakeup(multiM);
+#endif
+}
+
+void cSatipRtsp::ResetAbort(void)
+{
+  debug1("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
+  // An abort given between the requests is kept until a request consumes it or a new connection begins
+  __atomic_store_n(&abortM, 0, __ATOMIC_RELEASE);
+}
+
+void cSatipRtsp::OpenInterleave(void)
+{
+  debug1("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
+  CloseInterleave();
+  // The socket of the connection was picked up by the latest request
+  if (handleM && (socketM >= 0) && interleaveM.Open(socketM, interleavedRtpIdM, interleavedRtcpIdM)) {
+     if (cSatipPoller::GetInstance()->Register(interleaveM, tunerM.GetId())) {
+        debug1("%s Reading interleaved data from fd=%d [device %d]", __PRETTY_FUNCTION__, socketM, tunerM.GetId());
+        return;
+        }
+     interleaveM.Close();
+     }
+  info("Reading interleaved data only during RTSP requests [device %d]", tunerM.GetId());
+}
+
+void cSatipRtsp::CloseInterleave(void)
+{
+  debug16("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
+  if (interleaveM.IsOpen()) {
+     cSatipPoller::GetInstance()->Unregister(interleaveM);
+     interleaveM.Close();
+     }
+}
+
+CURLcode cSatipRtsp::Perform(void)
+{
+  debug16("%s [device %d]", __PRETTY_FUNCTION__, tunerM.GetId());
+  CURLcode res = CURLE_FAILED_INIT;
+  cTimeMs processing(0);
+
+  // Drive the transfer via the multi interface, so it can be aborted while waiting for a slow server.
+  // The request still blocks the calling tuner thread: its state machine needs each response before
+  // the next request, and no other thread waits for it, as the tuner doesn't hold its mutex here.
+  if (handleM && multiM && (curl_multi_add_handle(multiM, handleM) == CURLM_OK)) {
+     CURLMsg *msg;
+     int running = 1, left = 0;
+     // Any interleaved data in between belongs to curl
+     interleaveM.Suspend();
+     while (running) {
+           if (curl_multi_perform(multiM, &running) != CURLM_OK)
+              break;
+           if (!running)
+              break;
+           if (__atomic_exchange_n(&abortM, 0, __ATOMIC_ACQ_REL)) {
+              res = CURLE_ABORTED_BY_CALLBACK;
+              break;
+              }
+#if LIBCURL_VERSION_NUM >= 0x074400
+           curl_multi_poll(multiM, NULL, 0, eConnectTimeoutMs, NULL);
+#else
+           curl_multi_wait(multiM, NULL, 0, ePollTimeoutMs, NULL);
+#endif
+           }
+     while ((msg = curl_multi_info_read(multiM, &left)) != NULL) {
+           if ((msg->msg == CURLMSG_DONE) && (msg->easy_handle == handleM))
+              res = msg->data.result;
+           }
+     // The connection is known only as long as the handle is attached
+     CURLcode rc;
+#if LIBCURL_VERSION_NUM >= 0x072d00
+     curl_socket_t fd = CURL_SOCKET_BAD;
+     rc = curl_easy_getinfo(handleM, CURLINFO_ACTIVESOCKET, &fd);
+#else
+     long fd = -1;
+     rc = curl_easy_getinfo(handleM, CURLINFO_LASTSOCKET, &fd);
+#endif
+     socketM = (rc == CURLE_OK) ? (int)fd : -1;
+     curl_multi_remove_handle(multiM, handleM);
+     interleaveM.Resume();
+     // Follow the connection, if curl had to reconnect
+     if (interleaveM.IsOpen() && (interleaveM.GetFd() != socketM))
+        OpenInterleave();
+     // A request cut short leaves the connection and the CSeq of the handle out of sync,
+     // so start over with a fresh handle that still knows the session for a teardown
+     if (res == CURLE_ABORTED_BY_CALLBACK) {
+        char *id = NULL;
+        cString session = (curl_easy_getinfo(handleM, CURLINFO_RTSP_SESSION_ID, &id) == CURLE_OK) ? id : NULL;
+        Reset();
+        if (handleM && !isempty(*session))
+           curl_easy_setopt(handleM, CURLOPT_RTSP_SESSION_ID, *session);
+        }
+     }
+  if (res != CURLE_OK)
+     esyslog("curl_multi_perform() [%s,%d] failed: %s (%d)",  __FILE__, __LINE__, curl_easy_strerror(res), res);
+  // Only the tuner thread performs requests, the exporter just reads these
+  __atomic_store_n(&requestsM, requestsM + 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&requestTimeMsM, requestTimeMsM + processing.Elapsed(), __ATOMIC_RELAXED);
+  if (res != CURLE_OK)
+     __atomic_store_n(&requestFailuresM, requestFailuresM + 1, __ATOMIC_RELAXED);
+
+  return res;
+}
+
 bool cSatipRtsp::SetInterface(const char *bindAddrP)
 {
   debug1("%s (%s) [device %d]", __PRETTY_FUNCTION__, bindAddrP, tunerM.GetId());
@@ -211,15 +357,16 @@ bool cSatipRtsp::Receive(const char *uriP)
   debug1("%s (%s) [device %d]", __PRETTY_FUNCTION__, uriP, tunerM.GetId());
   bool result = false;
 
-  if (handleM && !isempty(uriP) && modeM == cSatipConfig::eTransportModeRtpOverTcp) {
+  if (handleM && !isempty(uriP) && IsReceivePolled()) {
      long rc = 0;
      cTimeMs processing(0);
      CURLcode res = CURLE_OK;
 
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_URL, uriP);
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_RTSP_STREAM_URI, uriP);
+     // Fallback for reading the interleaved data without the interleave reader
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_RTSP_REQUEST, (long)CURL_RTSPREQ_OPTIONS); // FIXME: this really should be CURL_RTSPREQ_RECEIVE, but getting timeout errors
-     SATIP_CURL_EASY_PERFORM(handleM);
+     Perform();
 
      result = ValidateLatestResponse(&rc);
      debug5("%s (%s) Response %ld in %" PRIu64 " ms [device %d]", __PRETTY_FUNCTION__, uriP, rc, processing.Elapsed(), tunerM.GetId());
@@ -241,7 +388,7 @@ bool cSatipRtsp::Options(const char *uriP)
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_URL, uriP);
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_RTSP_STREAM_URI, uriP);
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_RTSP_REQUEST, (long)CURL_RTSPREQ_OPTIONS);
-     SATIP_CURL_EASY_PERFORM(handleM);
+     Perform();
 
      result = ValidateLatestResponse(&rc);
      debug5("%s (%s) Response %ld in %" PRIu64 " ms [device %d]", __PRETTY_FUNCTION__, uriP, rc, processing.Elapsed(), tunerM.GetId());
@@ -288,7 +435,7 @@ bool cSatipRtsp::Setup(const char *uriP, int rtpPortP, int rtcpPortP, bool useTc
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_INTERLEAVEFUNCTION, NULL);
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_INTERLEAVEDATA, NULL);
 
-     SATIP_CURL_EASY_PERFORM(handleM);
+     Perform();
      // Session id is now known - disable header parsing
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_HEADERFUNCTION, NULL);
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_WRITEHEADER, NULL);
@@ -337,7 +484,7 @@ bool cSatipRtsp::Describe(const char *uriP)
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_RTSP_REQUEST, (long)CURL_RTSPREQ_DESCRIBE);
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_WRITEFUNCTION, cSatipRtsp::DataCallback);
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_WRITEDATA, this);
-     SATIP_CURL_EASY_PERFORM(handleM);
+     Perform();
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_WRITEFUNCTION, NULL);
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_WRITEDATA, NULL);
      if (dataBufferM.Size() > 0) {
@@ -366,7 +513,7 @@ bool cSatipRtsp::Play(const char *uriP)
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_RTSP_REQUEST, (long)CURL_RTSPREQ_PLAY);
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_WRITEFUNCTION, cSatipRtsp::DataCallback);
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_WRITEDATA, this);
-     SATIP_CURL_EASY_PERFORM(handleM);
+     Perform();
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_WRITEFUNCTION, NULL);
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_WRITEDATA, NULL);
      if (dataBufferM.Size() > 0) {
@@ -397,7 +544,7 @@ bool cSatipRtsp::Teardown(const char *uriP)
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_WRITEDATA, this);
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_INTERLEAVEFUNCTION, NULL);
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_INTERLEAVEDATA, NULL);
-     SATIP_CURL_EASY_PERFORM(handleM);
+     Perform();
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_WRITEFUNCTION, NULL);
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_WRITEDATA, NULL);
      if (dataBufferM.Size() > 0) {
@@ -444,6 +591,7 @@ void cSatipRtsp::ParseHeader(void)
            char *tmp = NULL, *destination = NULL, *source = NULL;
            interleavedRtpIdM = 0;
            interleavedRtcpIdM = 1;
+           CloseInterleave();
            SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_INTERLEAVEFUNCTION, NULL);
            SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_INTERLEAVEDATA, NULL);
            if (sscanf(r, "Transport:%m[^;];unicast;client_port=%11d-%11d", &tmp, &rtp, &rtcp) == 3) {
@@ -462,6 +610,7 @@ void cSatipRtsp::ParseHeader(void)
               SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_INTERLEAVEDATA, this);
               modeM = cSatipConfig::eTransportModeRtpOverTcp;
               tunerM.SetupTransport(-1, -1, NULL, NULL);
+              OpenInterleave();
               }
            FREE_POINTER(tmp);
            FREE_POINTER(destination);
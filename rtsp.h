@@ -10,12 +10,14 @@
 
 #include <curl/curl.h>
 #include <curl/easy.h>
+#include <curl/multi.h>
 
 #ifndef CURLOPT_RTSPHEADER
 #error "libcurl is missing required RTSP support"
 #endif
 
 #include "common.h"
+#include "interleave.h"
 #include "tunerif.h"
 
 class cSatipRtsp {
@@ -27,12 +29,16 @@ private:
 
   enum {
     eConnectTimeoutMs      = 1500,  // in milliseconds
+    ePollTimeoutMs         = 100,   // in milliseconds
   };
 
   cSatipTunerIf &tunerM;
   cSatipMemoryBuffer headerBufferM;
   cSatipMemoryBuffer dataBufferM;
   CURL *handleM;
+  CURLM *multiM;
+  int socketM;
+  int abortM;
   struct curl_slist *headerListM;
   cString errorNoMoreM;
   cString errorOutOfRangeM;
@@ -40,9 +46,16 @@ private:
   int modeM;
   unsigned int interleavedRtpIdM;
   unsigned int interleavedRtcpIdM;
+  cSatipInterleave interleaveM;
+  unsigned long requestsM;
+  unsigned long requestFailuresM;
+  unsigned long requestTimeMsM;
 
   void Create(void);
   void Destroy(void);
+  void OpenInterleave(void);
+  void CloseInterleave(void);
+  CURLcode Perform(void);
   void ParseHeader(void);
   void ParseData(void);
   bool ValidateLatestResponse(long *rcP);
@@ -56,8 +69,13 @@ public:
   virtual ~cSatipRtsp();
 
   cString GetActiveMode(void);
+  void GetRequestStatistics(unsigned long &requestsP, unsigned long &failuresP, unsigned long &timeMsP);
+  bool IsRtpOverTcp(void) const;
+  bool IsReceivePolled(void) const;
   cString RtspUnescapeString(const char *strP);
   void Reset(void);
+  void Abort(void);
+  void ResetAbort(void);
   bool SetInterface(const char *bindAddrP);
   bool Receive(const char *uriP);
   bool Options(const char *uriP);
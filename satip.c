@@ -14,7 +14,11 @@
 #include "discover.h"
 #include "log.h"
 #include "poller.h"
+#include "capture.h"
+#include "metrics.h"
+#include "share.h"
 #include "setup.h"
+#include "zap.h"
 
 #if defined(LIBCURL_VERSION_NUM) && LIBCURL_VERSION_NUM < 0x072400
 #warning "CURL version >= 7.36.0 is recommended"
@@ -115,7 +119,16 @@ const char *cPluginSatip::CommandLineHelp(void)
          "  -n, --noquirks                disable autodetection of the server quirks\n"
          "  -p, --portrange=<start>-<end> set a range of ports used for the RT[C]P server\n"
          "                                a minimum of 2 ports per device is required.\n"
-         "  -r, --rcvbuf                  override the size of the RTP receive buffer in bytes\n";
+         "  -r, --rcvbuf                  override the size of the RTP receive buffer in bytes\n"
+         "  -z, --zerocopy                receive RTP payload directly into the TS buffer\n"
+         "  -G, --gro                     let the kernel coalesce the RTP packets (UDP GRO)\n"
+         "  -T, --threads=<count>         set the number of poller threads shared by the devices\n"
+         "  -A, --affinity                pin the poller threads into separate CPU cores\n"
+         "  -R, --reorder=<depth>[,<ms>]  reorder RTP packets within a window of the given depth\n"
+         "                                and wait for a missing packet up to the given timeout\n"
+         "  -b, --batchtimeout=<ms>       wait up to the given time for filling an RTP receive batch\n"
+         "  -C, --capture=<interface>     capture the multicast streams from the given network interface\n"
+         "  -P, --pcr                     analyze the PCR interval, jitter and bitrate of the services\n";
 }
 
 bool cPluginSatip::ProcessArgs(int argc, char *argv[])
@@ -131,13 +144,21 @@ bool cPluginSatip::ProcessArgs(int argc, char *argv[])
     { "detach",   no_argument,       NULL, 'D' },
     { "single",   no_argument,       NULL, 'S' },
     { "noquirks", no_argument,       NULL, 'n' },
+    { "zerocopy", no_argument,       NULL, 'z' },
+    { "gro",      no_argument,       NULL, 'G' },
+    { "threads",  required_argument, NULL, 'T' },
+    { "affinity", no_argument,       NULL, 'A' },
+    { "reorder",  required_argument, NULL, 'R' },
+    { "batchtimeout", required_argument, NULL, 'b' },
+    { "capture",  required_argument, NULL, 'C' },
+    { "pcr",      no_argument,       NULL, 'P' },
     { NULL,       no_argument,       NULL,  0  }
     };
 
   cString server;
   cString portrange;
   int c;
-  while ((c = getopt_long(argc, argv, "d:t:s:p:r:DSn", long_options, NULL)) != -1) {
+  while ((c = getopt_long(argc, argv, "d:t:s:p:r:T:R:b:C:DSnzGAP", long_options, NULL)) != -1) {
     switch (c) {
       case 'd':
            deviceCountM = strtol(optarg, NULL, 0);
@@ -163,12 +184,45 @@ bool cPluginSatip::ProcessArgs(int argc, char *argv[])
       case 'r':
            SatipConfig.SetRtpRcvBufSize(strtol(optarg, NULL, 0));
            break;
+      case 'z':
+           SatipConfig.SetZeroCopy(true);
+           break;
+      case 'G':
+           SatipConfig.SetGro(true);
+           break;
+      case 'T':
+           SatipConfig.SetPollerThreads(strtol(optarg, NULL, 0));
+           break;
+      case 'A':
+           SatipConfig.SetPollerAffinity(true);
+           break;
+      case 'R': {
+           char *timeout = NULL;
+           SatipConfig.SetRtpReorderDepth(strtol(optarg, &timeout, 0));
+           if (timeout && (*timeout == ','))
+              SatipConfig.SetRtpReorderTimeout(strtol(timeout + 1, NULL, 0));
+           }
+           break;
+      case 'b':
+           SatipConfig.SetRtpBatchTimeout(strtol(optarg, NULL, 0));
+           break;
+      case 'C':
+           SatipConfig.SetCaptureInterface(optarg);
+           break;
+      case 'P':
+           SatipConfig.SetPcrAnalysis(true);
+           break;
       default:
            return false;
       }
     }
   if (!isempty(*portrange))
      ParsePortRange(portrange);
+  // a blocking read would delay the other devices served by the same poller thread
+  if (SatipConfig.GetRtpBatchTimeout() && (SatipConfig.GetPollerThreads() < min(deviceCountM, (unsigned int)SATIP_MAX_DEVICES))) {
+     error("The batch timeout requires a poller thread per device: %u < %u!", SatipConfig.GetPollerThreads(), min(deviceCountM, (unsigned int)SATIP_MAX_DEVICES));
+     SatipConfig.SetRtpBatchTimeout(0);
+     }
   // this must be done after all parameters are parsed
   if (!isempty(*server))
      ParseServer(*server);
@@ -182,6 +236,9 @@ bool cPluginSatip::Initialize(void)
   if (curl_global_init(CURL_GLOBAL_ALL) != CURLE_OK)
      error("Unable to initialize CURL");
   cSatipPoller::GetInstance()->Initialize();
+  cSatipCapture::GetInstance()->Initialize();
+  cSatipZapProfiler::GetInstance()->Initialize();
+  cSatipShares::GetInstance()->Initialize();
   cSatipDiscover::GetInstance()->Initialize(serversM);
   return cSatipDevice::Initialize(deviceCountM);
 }
@@ -198,6 +255,7 @@ bool cPluginSatip::Start(void)
          info = cString::sprintf("%s %s", *info, data->protocols[i]);
       }
   info("%s", *info);
+  cSatipMetrics::GetInstance()->Initialize();
   return true;
 }
 
@@ -205,8 +263,12 @@ void cPluginSatip::Stop(void)
 {
   debug1("%s", __PRETTY_FUNCTION__);
   // Stop any background activities the plugin is performing.
+  cSatipMetrics::GetInstance()->Destroy();
   cSatipDevice::Shutdown();
   cSatipDiscover::GetInstance()->Destroy();
+  cSatipCapture::GetInstance()->Destroy();
+  cSatipShares::GetInstance()->Destroy();
+  cSatipZapProfiler::GetInstance()->Destroy();
   cSatipPoller::GetInstance()->Destroy();
   curl_global_cleanup();
 }
@@ -417,6 +479,8 @@ bool cPluginSatip::SetupParse(const char *nameP, const char *valueP)
      SatipConfig.SetCIExtension(atoi(valueP));
   else if (!strcasecmp(nameP, "EnableFrontendReuse"))
      SatipConfig.SetFrontendReuse(atoi(valueP));
+  else if (!strcasecmp(nameP, "EnableFastTune"))
+     SatipConfig.SetFastTune(atoi(valueP));
   else if (!strcasecmp(nameP, "CICAM")) {
      int Cicams[MAX_CICAM_COUNT];
      for (unsigned int i = 0; i < ELEMENTS(Cicams); ++i)
@@ -445,6 +509,10 @@ bool cPluginSatip::SetupParse(const char *nameP, const char *valueP)
      }
   else if (!strcasecmp(nameP, "TransportMode"))
      SatipConfig.SetTransportMode(atoi(valueP));
+  else if (!strcasecmp(nameP, "MetricsPort"))
+     SatipConfig.SetMetricsPort(atoi(valueP));
+  else if (!strcasecmp(nameP, "MetricsAddress"))
+     SatipConfig.SetMetricsAddress(valueP);
   else
      return false;
   return true;
@@ -463,7 +531,10 @@ const char **cPluginSatip::SVDRPHelpPages(void)
     "INFO [ <page> ] [ <card index> ]\n"
     "    Prints SAT>IP device information and statistics.\n"
     "    The output can be narrowed using optional \"page\""
-    "    option: 1=general 2=pids 3=section filters.\n",
+    "    option: 1=general 2=pids 3=section filters 6=zap latency\n"
+    "    7=receive path (kernel drops and inter-arrival jitter of the sockets)\n"
+    "    8=transport stream monitor (TR 101 290 priority 1 errors)\n"
+    "    9=PCR interval, jitter and bitrate per service (requires --pcr).\n",
     "MODE\n"
     "    Toggles between bit or byte information mode.\n",
     "LIST\n"
@@ -482,6 +553,8 @@ const char **cPluginSatip::SVDRPHelpPages(void)
     "    Detachs active SAT>IP servers.\n",
     "TRAC [ <mode> ]\n"
     "    Gets and/or sets used tracing mode.\n",
+    "ZAPS\n"
+    "    Lists zap latency percentiles per SAT>IP server.\n",
     NULL
     };
   return HelpPages;
@@ -506,7 +579,7 @@ cString cPluginSatip::SVDRPCommand(const char *commandP, const char *optionP, in
         }
      if (isnumber(num)) {
         page = atoi(num);
-        if ((page < SATIP_DEVICE_INFO_ALL) || (page > SATIP_DEVICE_INFO_FILTERS))
+        if ((page < SATIP_DEVICE_INFO_ALL) || ((page > SATIP_DEVICE_INFO_FILTERS) && (page < SATIP_DEVICE_INFO_ZAP)) || (page > SATIP_DEVICE_INFO_PCR))
            page = SATIP_DEVICE_INFO_ALL;
         }
      free(opt);
@@ -592,6 +665,16 @@ cString cPluginSatip::SVDRPCommand(const char *commandP, const char *optionP, in
         SatipConfig.SetTraceMode(strtol(optionP, NULL, 0));
      return cString::sprintf("SATIP tracing mode: 0x%04X\n", SatipConfig.GetTraceMode());
      }
+  else if (strcasecmp(commandP, "ZAPS") == 0) {
+     cString list = cSatipZapProfiler::GetInstance()->GetInformation();
+     if (!isempty(list)) {
+        return list;
+        }
+     else {
+        replyCodeP = 550; // Requested action not taken
+        return cString("No SATIP zaps measured!");
+        }
+     }
 
   return NULL;
 }
@@ -20,12 +20,17 @@ cSatipSectionFilter::cSatipSectionFilter(int deviceIndexP, uint16_t pidP, uint8_
   pidM(pidP),
   tidM(tidP),
   maskM(maskP),
-  ringBufferM(new cRingBufferFrame(eDmxMaxSectionCount * eDmxMaxSectionSize)),
+  poolM(NULL),
+  poolHeadM(0),
+  poolTailM(0),
+  queuedM(0),
+  droppedM(0),
   deviceIndexM(deviceIndexP)
 {
   debug16("%s (%d, %d, %d, %d) [device %d]", __PRETTY_FUNCTION__, deviceIndexM, pidM, tidP, maskP, deviceIndexM);
 
   memset(secBufBaseM,     0, sizeof(secBufBaseM));
+  memset(poolLengthM,     0, sizeof(poolLengthM));
 
   // Create sockets
   socketM[0] = socketM[1] = -1;
@@ -51,7 +56,7 @@ cSatipSectionFilter::~cSatipSectionFilter()
   if (tmp >= 0)
      close(tmp);
   secBufM = NULL;
-  DELETENULL(ringBufferM);
+  FREE_POINTER(poolM);
 }
 
 inline uint16_t cSatipSectionFilter::GetLength(const uint8_t *dataP)
@@ -69,16 +74,50 @@ int cSatipSectionFilter::Filter(void)
 {
   if (secBufM) {
      if ((tidM & maskM) == (secBufM[0] & maskM)) {
-        if (ringBufferM && (secLenM > 0)) {
-           cFrame* section = new cFrame(secBufM, secLenM);
-           if (!ringBufferM->Put(section))
-              DELETE_POINTER(section);
+        if (secLenM > 0) {
+           // Write directly into the socket unless there's already a backlog to keep the order
+           if (Available() || (Deliver(secBufM, secLenM) == -EAGAIN))
+              Queue(secBufM, secLenM);
            }
         }
      }
   return 0;
 }
 
+int cSatipSectionFilter::Deliver(const uint8_t *dataP, int lengthP)
+{
+  if ((socketM[1] < 0) || (socketM[0] < 0))
+     return -EBADF;
+  if (send(socketM[1], dataP, lengthP, MSG_EOR | MSG_DONTWAIT) > 0) {
+     // Update statistics
+     AddSectionStatistic(lengthP, 1);
+     return 0;
+     }
+  if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+     return -EAGAIN;
+  error("failed to send section data (%i bytes) [device=%d]", lengthP, deviceIndexM);
+  return -errno;
+}
+
+void cSatipSectionFilter::Queue(const uint8_t *dataP, int lengthP)
+{
+  // The pool is needed only by slow readers, so create it on demand
+  if (!poolM && ((poolM = MALLOC(uint8_t, eDmxMaxSectionCount * eDmxMaxSectionSize)) == NULL)) {
+     error("Cannot create section pool (device=%d pid=%d)", deviceIndexM, pidM);
+     droppedM++;
+     return;
+     }
+  if ((poolHeadM - poolTailM >= eDmxMaxSectionCount) || (lengthP > eDmxMaxSectionSize)) {
+     droppedM++;
+     return;
+     }
+  unsigned int slot = poolHeadM % eDmxMaxSectionCount;
+  memcpy(poolM + slot * eDmxMaxSectionSize, dataP, lengthP);
+  poolLengthM[slot] = (uint16_t)lengthP;
+  queuedM += lengthP;
+  poolHeadM++;
+}
+
 inline int cSatipSectionFilter::Feed(void)
 {
   if (Filter() < 0)
@@ -125,13 +164,6 @@ int cSatipSectionFilter::CopyDump(const uint8_t *bufP, uint8_t lenP)
 
 void cSatipSectionFilter::Process(const uint8_t* dataP)
 {
-  if (dataP[0] != TS_SYNC_BYTE)
-     return;
-
-  // Stop if not the PID this filter is looking for
-  if (ts_pid(dataP) != pidM)
-     return;
-
   uint8_t count = payload(dataP);
 
   // Check if no payload or out of range
@@ -180,27 +212,17 @@ void cSatipSectionFilter::Process(const uint8_t* dataP)
      }
 }
 
-void cSatipSectionFilter::Send(void)
+bool cSatipSectionFilter::Send(void)
 {
-  cFrame *section = ringBufferM->Get();
-  if (section) {
-     uchar *data = section->Data();
-     int count = section->Count();
-     if (data && (count > 0) && (socketM[1] >= 0) && (socketM[0] >= 0)) {
-        if (send(socketM[1], data, count, MSG_EOR) > 0) {
-           // Update statistics
-           AddSectionStatistic(count, 1);
-           }
-        else if (errno != EAGAIN)
-          error("failed to send section data (%i bytes) [device=%d]", count, deviceIndexM);
+  // Flush the backlog until the socket gets full again
+  while (poolTailM != poolHeadM) {
+        unsigned int slot = poolTailM % eDmxMaxSectionCount;
+        if (Deliver(poolM + slot * eDmxMaxSectionSize, poolLengthM[slot]) == -EAGAIN)
+           return false;
+        queuedM -= poolLengthM[slot];
+        poolTailM++;
         }
-     ringBufferM->Drop(section);
-     }
-}
-
-int cSatipSectionFilter::Available(void) const
-{
-  return ringBufferM->Available();
+  return true;
 }
 
 cSatipSectionFilterHandler::cSatipSectionFilterHandler(int deviceIndexP, unsigned int bufferLenP)
@@ -213,6 +235,8 @@ cSatipSectionFilterHandler::cSatipSectionFilterHandler(int deviceIndexP, unsigne
 
   // Initialize filter pointers
   memset(filtersM, 0, sizeof(filtersM));
+  memset(pidFiltersM, 0, sizeof(pidFiltersM));
+  memset(pidBitmapM, 0, sizeof(pidBitmapM));
 
   // Create input buffer
   if (ringBufferM) {
@@ -242,34 +266,28 @@ cSatipSectionFilterHandler::~cSatipSectionFilterHandler()
 void cSatipSectionFilterHandler::SendAll(void)
 {
   cMutexLock MutexLock(&mutexM);
-  bool pendingData;
-  do {
-     pendingData = false;
-
-     // zero polling structures
-     memset(pollFdsM, 0, sizeof(pollFdsM));
-
-     // assemble all handlers to poll (use -1 to ignore handlers)
-     for (unsigned int i = 0; i < eMaxSecFilterCount; ++i) {
-         if (filtersM[i] && filtersM[i]->Available() != 0) {
-            pollFdsM[i].fd = filtersM[i]->GetFd();
-            pollFdsM[i].events = POLLOUT;
-            pendingData = true;
-            }
-         else
-            pollFdsM[i].fd = -1;
-         }
-
-     // exit if there isn't any pending data or we time out
-     if (!pendingData || poll(pollFdsM, eMaxSecFilterCount, eSecFilterSendTimeoutMs) <= 0)
-        return;
-
-     // send data (if available)
-     for (unsigned int i = 0; i < eMaxSecFilterCount && pendingData; ++i) {
-         if (pollFdsM[i].revents & POLLOUT)
-            filtersM[i]->Send();
-         }
-  } while (pendingData);
+  for (;;) {
+      // assemble only the filters having a backlog to poll
+      int count = 0;
+      for (unsigned int i = 0; i < eMaxSecFilterCount; ++i) {
+          if (filtersM[i] && filtersM[i]->Available() != 0) {
+             pollFdsM[count].fd = filtersM[i]->GetFd();
+             pollFdsM[count].events = POLLOUT;
+             pollFdsM[count].revents = 0;
+             pollFiltersM[count++] = filtersM[i];
+             }
+          }
+
+      // exit if there isn't any pending data or we time out
+      if (!count || poll(pollFdsM, count, eSecFilterSendTimeoutMs) <= 0)
+         return;
+
+      // send data (if available)
+      for (int i = 0; i < count; ++i) {
+          if (pollFdsM[i].revents & POLLOUT)
+             pollFiltersM[i]->Send();
+          }
+      }
 }
 
 void cSatipSectionFilterHandler::Action(void)
@@ -293,16 +311,17 @@ void cSatipSectionFilterHandler::Action(void)
                     debug1("%s Skipped %d bytes to sync on TS packet [device %d]", __PRETTY_FUNCTION__, len, deviceIndexM);
                     continue;
                     }
-                    // Process TS packet through all filters
-                    mutexM.Lock();
-                    for (unsigned int i = 0; i < eMaxSecFilterCount; ++i) {
-                        if (filtersM[i])
-                           filtersM[i]->Process(p);
-                        }
-                    mutexM.Unlock();
-                    ringBufferM->Del(TS_SIZE);
-                    }
-                }
+                 // Process the whole run of synced TS packets only through the filters of each pid
+                 int processed = 0;
+                 mutexM.Lock();
+                 for (; (processed + TS_SIZE <= len) && (p[processed] == TS_SYNC_BYTE); processed += TS_SIZE) {
+                     for (uint32_t mask = pidFiltersM[ts_pid(p + processed)]; mask; mask &= mask - 1)
+                         filtersM[__builtin_ctz(mask)]->Process(p + processed);
+                     }
+                 mutexM.Unlock();
+                 ringBufferM->Del(processed);
+                 }
+              }
 
         // Send demuxed section packets through all filters
         SendAll();
@@ -319,9 +338,9 @@ cString cSatipSectionFilterHandler::GetInformation(void)
   unsigned int count = 0;
   for (unsigned int i = 0; i < eMaxSecFilterCount; ++i) {
       if (filtersM[i]) {
-         s = cString::sprintf("%sFilter %d: %s Pid=0x%02X (%s)\n", *s, i,
+         s = cString::sprintf("%sFilter %d: %s Pid=0x%02X (%s) Queued=%d Dropped=%ld\n", *s, i,
                               *filtersM[i]->GetSectionStatistic(), filtersM[i]->GetPid(),
-                              id_pid(filtersM[i]->GetPid()));
+                              id_pid(filtersM[i]->GetPid()), filtersM[i]->Available(), filtersM[i]->Dropped());
          if (++count > SATIP_STATS_ACTIVE_FILTERS_COUNT)
             break;
          }
@@ -333,12 +352,10 @@ bool cSatipSectionFilterHandler::Exists(u_short pidP)
 {
   debug16("%s (%d) [device %d]", __PRETTY_FUNCTION__, pidP, deviceIndexM);
   cMutexLock MutexLock(&mutexM);
-  for (unsigned int i = 0; i < eMaxSecFilterCount; ++i) {
-      if (filtersM[i] && (pidP == filtersM[i]->GetPid())) {
-         debug12("%s (%d) Found [device %d]", __PRETTY_FUNCTION__, pidP, deviceIndexM);
-         return true;
-         }
-      }
+  if (pidFiltersM[pidP & (MAXPID - 1)]) {
+     debug12("%s (%d) Found [device %d]", __PRETTY_FUNCTION__, pidP, deviceIndexM);
+     return true;
+     }
   return false;
 }
 
@@ -348,6 +365,10 @@ bool cSatipSectionFilterHandler::Delete(unsigned int indexP)
   if ((indexP < eMaxSecFilterCount) && filtersM[indexP]) {
      debug8("%s (%d) Found [device %d]", __PRETTY_FUNCTION__, indexP, deviceIndexM);
      cSatipSectionFilter *tmp = filtersM[indexP];
+     int pid = tmp->GetPid() & (MAXPID - 1);
+     pidFiltersM[pid] &= ~(1U << indexP);
+     if (!pidFiltersM[pid])
+        __atomic_fetch_and(&pidBitmapM[pid / 32], ~(1U << (pid % 32)), __ATOMIC_RELAXED);
      filtersM[indexP] = NULL;
      delete tmp;
      return true;
@@ -382,6 +403,8 @@ int cSatipSectionFilterHandler::Open(u_short pidP, u_char tidP, u_char maskP)
   for (unsigned int i = 0; i < eMaxSecFilterCount; ++i) {
       if (!filtersM[i]) {
          filtersM[i] = new cSatipSectionFilter(deviceIndexM, pidP, tidP, maskP);
+         pidFiltersM[pidP & (MAXPID - 1)] |= (1U << i);
+         __atomic_fetch_or(&pidBitmapM[(pidP & (MAXPID - 1)) / 32], 1U << (pidP % 32), __ATOMIC_RELAXED);
          debug16("%s (%d, %02X, %02X) handle=%d index=%u [device %d]", __PRETTY_FUNCTION__, pidP, tidP, maskP, filtersM[i]->GetFd(), i, deviceIndexM);
          return filtersM[i]->GetFd();
          }
@@ -416,13 +439,29 @@ int cSatipSectionFilterHandler::GetPid(int handleP)
   return -1;
 }
 
+bool cSatipSectionFilterHandler::IsWanted(const u_char *dataP) const
+{
+  int pid = ts_pid(dataP);
+  return (dataP[0] == TS_SYNC_BYTE) && (__atomic_load_n(&pidBitmapM[pid / 32], __ATOMIC_RELAXED) & (1U << (pid % 32)));
+}
+
 void cSatipSectionFilterHandler::Write(uchar *bufferP, int lengthP)
 {
   debug16("%s (, %d) [device %d]", __PRETTY_FUNCTION__, lengthP, deviceIndexM);
-  // Fill up the buffer
+  // Fill up the buffer with runs of packets having any filter
   if (ringBufferM) {
-     int len = ringBufferM->Put(bufferP, lengthP);
-     if (len != lengthP)
-        ringBufferM->ReportOverflow(lengthP - len);
+     for (int i = 0; i + TS_SIZE <= lengthP; ) {
+         if (!IsWanted(bufferP + i)) {
+            i += TS_SIZE;
+            continue;
+            }
+         int start = i;
+         do {
+            i += TS_SIZE;
+         } while ((i + TS_SIZE <= lengthP) && IsWanted(bufferP + i));
+         int len = ringBufferM->Put(bufferP + start, i - start);
+         if (len != i - start)
+            ringBufferM->ReportOverflow(i - start - len);
+         }
      }
 }
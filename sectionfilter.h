@@ -36,7 +36,13 @@ private:
   uint8_t tidM;
   uint8_t maskM;
 
-  cRingBufferFrame *ringBufferM;
+  // fixed slab of section buffers recycled in FIFO order
+  uint8_t *poolM;
+  uint16_t poolLengthM[eDmxMaxSectionCount];
+  unsigned int poolHeadM;
+  unsigned int poolTailM;
+  int queuedM;
+  long droppedM; // due to pool exhaustion
   int deviceIndexM;
   int socketM[2];
 
@@ -45,31 +51,41 @@ private:
   int Filter(void);
   inline int Feed(void);
   int CopyDump(const uint8_t *bufP, uint8_t lenP);
+  int Deliver(const uint8_t *dataP, int lengthP);
+  void Queue(const uint8_t *dataP, int lengthP);
 
 public:
   // constructor & destructor
   cSatipSectionFilter(int deviceIndexP, uint16_t pidP, uint8_t tidP, uint8_t maskP);
   virtual ~cSatipSectionFilter();
+  // the caller must ensure that the packet is in sync and of this pid
   void Process(const uint8_t* dataP);
-  void Send(void);
+  bool Send(void);
   int GetFd(void) { return socketM[0]; }
   uint16_t GetPid(void) const { return pidM; }
-  int Available(void) const;
+  int Available(void) const { return queuedM; }
+  long Dropped(void) const { return droppedM; }
 };
 
 class cSatipSectionFilterHandler : public cThread {
 private:
   enum {
-    eMaxSecFilterCount = 32,
+    eMaxSecFilterCount = 32, // must fit into the pid bitmask
     eSecFilterSendTimeoutMs = 10
   };
   cRingBufferLinear *ringBufferM;
   cMutex mutexM;
   int deviceIndexM;
   cSatipSectionFilter *filtersM[eMaxSecFilterCount];
+  // bitmask of filter slots per pid
+  uint32_t pidFiltersM[MAXPID];
+  // bitmap of pids with any filter, read without locking by the writer
+  uint32_t pidBitmapM[MAXPID / 32];
   struct pollfd pollFdsM[eMaxSecFilterCount];
+  cSatipSectionFilter *pollFiltersM[eMaxSecFilterCount];
 
   bool Delete(unsigned int indexP);
+  bool IsWanted(const u_char *dataP) const;
   bool IsBlackListed(u_short pidP, u_char tidP, u_char maskP) const;
   void SendAll(void);
 
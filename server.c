@@ -11,6 +11,7 @@
 #include "common.h"
 #include "log.h"
 #include "server.h"
+#include "share.h"
 
 // --- cSatipFrontend ---------------------------------------------------------
 
@@ -37,11 +38,16 @@ bool cSatipFrontends::Matches(int deviceIdP, int transponderP)
   return false;
 }
 
-bool cSatipFrontends::Assign(int deviceIdP, int transponderP)
+bool cSatipFrontends::Assign(int deviceIdP, int transponderP, bool sharedP)
 {
   cSatipFrontend *tmp = NULL;
   // Prefer any used one
   for (cSatipFrontend *f = First(); f; f = Next(f)) {
+      // A ready multicast stream of the same transponder is shared by the devices
+      if (sharedP && f->Attached() && (f->Transponder() == transponderP)) {
+         tmp = f;
+         break;
+         }
       if (f->DeviceId() == deviceIdP) {  // give deviceID priority, but take detached frontend if deviceID ist not yet attached
          tmp = f;
          break;
@@ -92,6 +98,15 @@ bool cSatipFrontends::Detach(int deviceIdP, int transponderP)
   return false;
 }
 
+bool cSatipFrontends::IsAttached(void)
+{
+  for (cSatipFrontend *f = First(); f; f = Next(f)) {
+      if (f->Attached())
+         return true;
+      }
+  return false;
+}
+
 // --- cSatipServer -----------------------------------------------------------
 
 cSatipServer::cSatipServer(const char *srcAddressP, const char *addressP, const int portP, const char *modelP, const char *filtersP, const char *descriptionP, const int quirkP)
@@ -269,23 +284,25 @@ bool cSatipServer::IsValidSource(int sourceP)
 bool cSatipServer::Assign(int deviceIdP, int sourceP, int systemP, int transponderP)
 {
   bool result = false;
+  // Only a stream, that is set up already, can be joined without a frontend
+  bool shared = SatipConfig.IsTransportModeMulticast() && cSatipShares::GetInstance()->IsReady(this, transponderP);
   if (IsValidSource(sourceP)) {
      if (cSource::IsType(sourceP, 'S'))
-        result = frontendsM[eSatipFrontendDVBS2].Assign(deviceIdP, transponderP);
+        result = frontendsM[eSatipFrontendDVBS2].Assign(deviceIdP, transponderP, shared);
      else if (cSource::IsType(sourceP, 'T')) {
         if (systemP)
-           result = frontendsM[eSatipFrontendDVBT2].Assign(deviceIdP, transponderP);
+           result = frontendsM[eSatipFrontendDVBT2].Assign(deviceIdP, transponderP, shared);
         else
-           result = frontendsM[eSatipFrontendDVBT].Assign(deviceIdP, transponderP) || frontendsM[eSatipFrontendDVBT2].Assign(deviceIdP, transponderP);
+           result = frontendsM[eSatipFrontendDVBT].Assign(deviceIdP, transponderP, shared) || frontendsM[eSatipFrontendDVBT2].Assign(deviceIdP, transponderP, shared);
         }
      else if (cSource::IsType(sourceP, 'C')) {
         if (systemP)
-           result = frontendsM[eSatipFrontendDVBC2].Assign(deviceIdP, transponderP);
+           result = frontendsM[eSatipFrontendDVBC2].Assign(deviceIdP, transponderP, shared);
         else
-           result = frontendsM[eSatipFrontendDVBC].Assign(deviceIdP, transponderP) || frontendsM[eSatipFrontendDVBC2].Assign(deviceIdP, transponderP);
+           result = frontendsM[eSatipFrontendDVBC].Assign(deviceIdP, transponderP, shared) || frontendsM[eSatipFrontendDVBC2].Assign(deviceIdP, transponderP, shared);
         }
      else if (cSource::IsType(sourceP, 'A'))
-        result = frontendsM[eSatipFrontendATSC].Assign(deviceIdP, transponderP);
+        result = frontendsM[eSatipFrontendATSC].Assign(deviceIdP, transponderP, shared);
      }
   return result;
 }
@@ -345,6 +362,15 @@ void cSatipServer::Detach(int deviceIdP, int transponderP)
       }
 }
 
+bool cSatipServer::IsAttached(void)
+{
+  for (int i = 0; i < eSatipFrontendCount; ++i) {
+      if (frontendsM[i].IsAttached())
+         return true;
+      }
+  return false;
+}
+
 int cSatipServer::GetModulesDVBS2(void)
 {
   return frontendsM[eSatipFrontendDVBS2].Count();
@@ -473,6 +499,18 @@ bool cSatipServers::HasCI(cSatipServer *serverP)
   return result;
 }
 
+bool cSatipServers::IsAttached(cSatipServer *serverP)
+{
+  bool result = false;
+  for (cSatipServer *s = First(); s; s = Next(s)) {
+      if (s == serverP) {
+         result = s->IsAttached();
+         break;
+         }
+      }
+  return result;
+}
+
 void cSatipServers::Cleanup(uint64_t intervalMsP)
 {
   for (cSatipServer *s = First(); s; s = Next(s)) {
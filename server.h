@@ -37,9 +37,10 @@ public:
 class cSatipFrontends : public cList<cSatipFrontend> {
 public:
   bool Matches(int deviceIdP, int transponderP);
-  bool Assign(int deviceIdP, int transponderP);
+  bool Assign(int deviceIdP, int transponderP, bool sharedP = false);
   bool Attach(int deviceIdP, int transponderP);
   bool Detach(int deviceIdP, int transponderP);
+  bool IsAttached(void);
 };
 
 // --- cSatipServer -----------------------------------------------------------
@@ -95,6 +96,7 @@ public:
   bool Matches(int deviceIdP, int sourceP, int systemP, int transponderP);
   void Attach(int deviceIdP, int transponderP);
   void Detach(int deviceIdP, int transponderP);
+  bool IsAttached(void);
   int GetModulesDVBS2(void);
   int GetModulesDVBT(void);
   int GetModulesDVBT2(void);
@@ -131,6 +133,7 @@ public:
   void Detach(cSatipServer *serverP, int deviceIdP, int transponderP);
   bool IsQuirk(cSatipServer *serverP, int quirkP);
   bool HasCI(cSatipServer *serverP);
+  bool IsAttached(cSatipServer *serverP);
   void Cleanup(uint64_t intervalMsP = 0);
   cString GetAddress(cSatipServer *serverP);
   cString GetSrcAddress(cSatipServer *serverP);
@@ -348,6 +348,8 @@ cSatipPluginSetup::cSatipPluginSetup()
   transportModeM(SatipConfig.GetTransportMode()),
   ciExtensionM(SatipConfig.GetCIExtension()),
   frontendReuseM(SatipConfig.GetFrontendReuse()),
+  fastTuneM(SatipConfig.GetFastTune()),
+  metricsPortM(SatipConfig.GetMetricsPort()),
   eitScanM(SatipConfig.GetEITScan()),
   numDisabledSourcesM(SatipConfig.GetDisabledSourcesCount()),
   numDisabledFiltersM(SatipConfig.GetDisabledFiltersCount())
@@ -374,6 +376,7 @@ cSatipPluginSetup::cSatipPluginSetup()
       disabledFilterIndexesM[i] = SatipConfig.GetDisabledFilters(i);
       disabledFilterNamesM[i] = tr(section_filter_table[i].description);
       }
+  strn0cpy(metricsAddressM, SatipConfig.GetMetricsAddress(), sizeof(metricsAddressM));
   SetMenuCategory(mcSetupPlugins);
   Setup();
   SetHelp(trVDR("Button$Scan"), NULL, tr("Button$Devices"), trVDR("Button$Info"));
@@ -423,6 +426,17 @@ void cSatipPluginSetup::Setup(void)
   Add(new cMenuEditBoolItem(tr("Enable frontend reuse"), &frontendReuseM));
   helpM.Append(tr("Define whether reusing a frontend for multiple channels in a transponder should be enabled."));
 
+  Add(new cMenuEditBoolItem(tr("Enable fast tuning"), &fastTuneM));
+  helpM.Append(tr("Define whether channel switching shall minimize the RTSP round trips.\n\nThis setting includes the pids already in the SETUP request and skips the OPTIONS request, if the SAT>IP server is known to be alive."));
+
+  Add(new cMenuEditIntItem(tr("Metrics port"), &metricsPortM, 0, 65535, tr("off")));
+  helpM.Append(tr("Define the TCP port of the metrics endpoint.\n\nThe statistics of all SAT>IP devices are served at http://<address>:<port>/metrics in the OpenMetrics format."));
+
+  if (metricsPortM) {
+     Add(new cMenuEditStrItem(tr("Metrics address"), metricsAddressM, sizeof(metricsAddressM), "0123456789."));
+     helpM.Append(tr("Define the IP address the metrics endpoint is bound to.\n\nUse 0.0.0.0 to serve all network interfaces."));
+     }
+
   Add(new cOsdItem(tr("Active SAT>IP servers:"), osUnknown, false));
   helpM.Append("");
 
@@ -485,6 +499,7 @@ eOSState cSatipPluginSetup::ProcessKey(eKeys keyP)
   int oldOperatingMode = operatingModeM;
   int oldCiExtension = ciExtensionM;
   int oldFrontendReuse = frontendReuseM;
+  int oldMetricsPort = metricsPortM;
   int oldNumDisabledSources = numDisabledSourcesM;
   int oldNumDisabledFilters = numDisabledFiltersM;
   eOSState state = cMenuSetupPage::ProcessKey(keyP);
@@ -510,7 +525,7 @@ eOSState cSatipPluginSetup::ProcessKey(eKeys keyP)
   if ((keyP == kNone) && (cSatipDiscover::GetInstance()->GetServers()->Count() != deviceCountM))
      Setup();
 
-  if ((keyP != kNone) && ((numDisabledSourcesM != oldNumDisabledSources) || (numDisabledFiltersM != oldNumDisabledFilters) || (operatingModeM != oldOperatingMode) || (ciExtensionM != oldCiExtension) || ( oldFrontendReuse != frontendReuseM) || (detachedModeM != SatipConfig.GetDetachedMode()))) {
+  if ((keyP != kNone) && ((numDisabledSourcesM != oldNumDisabledSources) || (numDisabledFiltersM != oldNumDisabledFilters) || (operatingModeM != oldOperatingMode) || (ciExtensionM != oldCiExtension) || ( oldFrontendReuse != frontendReuseM) || (!oldMetricsPort != !metricsPortM) || (detachedModeM != SatipConfig.GetDetachedMode()))) {
      while ((numDisabledSourcesM < oldNumDisabledSources) && (oldNumDisabledSources > 0))
            disabledSourcesM[--oldNumDisabledSources] = cSource::stNone;
      while ((numDisabledFiltersM < oldNumDisabledFilters) && (oldNumDisabledFilters > 0))
@@ -576,7 +591,10 @@ void cSatipPluginSetup::Store(void)
   SetupStore("TransportMode", transportModeM);
   SetupStore("EnableCIExtension", ciExtensionM);
   SetupStore("EnableFrontendReuse", frontendReuseM);
+  SetupStore("EnableFastTune", fastTuneM);
   SetupStore("EnableEITScan", eitScanM);
+  SetupStore("MetricsPort", metricsPortM);
+  SetupStore("MetricsAddress", metricsAddressM);
   StoreCicams("CICAM", cicamsM);
   StoreSources("DisabledSources", disabledSourcesM);
   StoreFilters("DisabledFilters", disabledFilterIndexesM);
@@ -584,7 +602,10 @@ void cSatipPluginSetup::Store(void)
   SatipConfig.SetOperatingMode(operatingModeM);
   SatipConfig.SetTransportMode(transportModeM);
   SatipConfig.SetCIExtension(ciExtensionM);
+  SatipConfig.SetFastTune(fastTuneM);
   SatipConfig.SetEITScan(eitScanM);
+  SatipConfig.SetMetricsPort(metricsPortM);
+  SatipConfig.SetMetricsAddress(metricsAddressM);
   for (int i = 0; i < MAX_CICAM_COUNT; ++i)
       SatipConfig.SetCICAM(i, cicamsM[i]);
   for (int i = 0; i < MAX_DISABLED_SOURCES_COUNT; ++i)
@@ -23,6 +23,9 @@ private:
   const char *transportModeTextsM[cSatipConfig::eTransportModeCount];
   int ciExtensionM;
   int frontendReuseM;
+  int fastTuneM;
+  int metricsPortM;
+  char metricsAddressM[16];
   int cicamsM[MAX_CICAM_COUNT];
   const char *cicamTextsM[CA_SYSTEMS_TABLE_SIZE];
   int eitScanM;
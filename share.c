@@ -0,0 +1,242 @@
+/*
+ * share.c: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include "common.h"
+#include "log.h"
+#include "share.h"
+#include "tuner.h"
+
+// --- cSatipShare ------------------------------------------------------------
+
+cSatipShare::cSatipShare(const char *keyP, cSatipServer *serverP, int transponderP, cSatipTunerIf &ownerP)
+: keyM(keyP),
+  serverM(serverP),
+  transponderM(transponderP),
+  ownerM(&ownerP),
+  membersM(),
+  readyM(false),
+  streamAddrM(""),
+  sourceAddrM(""),
+  rtpPortM(-1),
+  rtcpPortM(-1),
+  sessionM(""),
+  streamIdM(-1),
+  timeoutM(0)
+{
+  membersM.Append(&ownerP);
+}
+
+cSatipShare::~cSatipShare()
+{
+}
+
+void cSatipShare::Add(cSatipTunerIf &tunerP)
+{
+  membersM.AppendUnique(&tunerP);
+}
+
+bool cSatipShare::Remove(cSatipTunerIf &tunerP)
+{
+  int id = tunerP.GetId();
+  if ((id >= 0) && (id < SATIP_MAX_DEVICES))
+     pidsM[id] = "";
+  if (!membersM.RemoveElement(&tunerP))
+     return false;
+  if (ownerM == &tunerP)
+     ownerM = membersM.Size() ? membersM[0] : NULL;
+  return true;
+}
+
+bool cSatipShare::SetPids(cSatipTunerIf &tunerP, const char *pidsP)
+{
+  int id = tunerP.GetId();
+  if ((id < 0) || (id >= SATIP_MAX_DEVICES) || !strcmp(*pidsM[id] ? *pidsM[id] : "", pidsP ? pidsP : ""))
+     return false;
+  pidsM[id] = pidsP;
+  return true;
+}
+
+cString cSatipShare::GetPids(void)
+{
+  cSatipPid pids, all;
+  for (int i = 0; i < SATIP_MAX_DEVICES; ++i) {
+      pids.ParsePids(*pidsM[i]);
+      for (int j = 0; j < pids.Size(); ++j)
+          all.AddPid(pids[j]);
+      }
+  return all.ListPids();
+}
+
+void cSatipShare::Publish(const char *streamAddrP, const char *sourceAddrP, int rtpPortP, int rtcpPortP, const char *sessionP, int streamIdP, int timeoutP)
+{
+  streamAddrM = streamAddrP;
+  sourceAddrM = sourceAddrP;
+  rtpPortM = rtpPortP;
+  rtcpPortM = rtcpPortP;
+  sessionM = sessionP;
+  streamIdM = streamIdP;
+  timeoutM = timeoutP;
+  readyM = true;
+}
+
+void cSatipShare::GetTransport(cString &streamAddrP, cString &sourceAddrP, int &rtpPortP, int &rtcpPortP)
+{
+  streamAddrP = streamAddrM;
+  sourceAddrP = sourceAddrM;
+  rtpPortP = rtpPortM;
+  rtcpPortP = rtcpPortM;
+}
+
+// --- cSatipShares -----------------------------------------------------------
+
+cSatipShares *cSatipShares::instanceS = NULL;
+
+cSatipShares *cSatipShares::GetInstance(void)
+{
+  if (!instanceS)
+     instanceS = new cSatipShares();
+  return instanceS;
+}
+
+bool cSatipShares::Initialize(void)
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+  // Created by the main thread before the tuners and the servers use it
+  GetInstance();
+  return true;
+}
+
+void cSatipShares::Destroy(void)
+{
+  DELETE_POINTER(instanceS);
+}
+
+cSatipShares::cSatipShares()
+: mutexM(),
+  listMutexM(),
+  sharesM()
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+}
+
+cSatipShares::~cSatipShares()
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+  cMutexLock MutexLock(&mutexM);
+  cMutexLock ListLock(&listMutexM);
+  sharesM.Clear();
+}
+
+cSatipShare *cSatipShares::Find(const char *keyP)
+{
+  for (cSatipShare *s = sharesM.First(); s; s = sharesM.Next(s)) {
+      if (!strcmp(s->Key(), keyP))
+         return s;
+      }
+  return NULL;
+}
+
+int cSatipShares::Join(const char *keyP, cSatipServer *serverP, int transponderP, cSatipTunerIf &tunerP, cString &streamAddrP, cString &sourceAddrP, int &rtpPortP, int &rtcpPortP)
+{
+  debug1("%s (%s, %d) [device %d]", __PRETTY_FUNCTION__, keyP, transponderP, tunerP.GetId());
+  cMutexLock MutexLock(&mutexM);
+  cSatipShare *s = Find(keyP);
+  if (!s) {
+     cMutexLock ListLock(&listMutexM);
+     sharesM.Add(new cSatipShare(keyP, serverP, transponderP, tunerP));
+     return eShareOwner;
+     }
+  if (s->Owner() == &tunerP)
+     return eShareOwner;
+  // Wait for the owner to get the stream set up
+  if (!s->IsReady())
+     return eSharePending;
+  s->Add(tunerP);
+  s->GetTransport(streamAddrP, sourceAddrP, rtpPortP, rtcpPortP);
+  info("Sharing the stream of device %d [device %d]", s->Owner()->GetId(), tunerP.GetId());
+  return eShareFollower;
+}
+
+void cSatipShares::Publish(const char *keyP, cSatipTunerIf &tunerP, const char *streamAddrP, const char *sourceAddrP, int rtpPortP, int rtcpPortP, const char *sessionP, int streamIdP, int timeoutP)
+{
+  debug1("%s (%s, %s, %s, %d, %d, %s, %d, %d) [device %d]", __PRETTY_FUNCTION__, keyP, streamAddrP, sourceAddrP, rtpPortP, rtcpPortP, sessionP, streamIdP, timeoutP, tunerP.GetId());
+  cMutexLock MutexLock(&mutexM);
+  cSatipShare *s = Find(keyP);
+  if (s && (s->Owner() == &tunerP)) {
+     cMutexLock ListLock(&listMutexM);
+     s->Publish(streamAddrP, sourceAddrP, rtpPortP, rtcpPortP, sessionP, streamIdP, timeoutP);
+     }
+}
+
+bool cSatipShares::Leave(const char *keyP, cSatipTunerIf &tunerP)
+{
+  debug1("%s (%s) [device %d]", __PRETTY_FUNCTION__, keyP, tunerP.GetId());
+  cSatipTunerIf *next = NULL;
+  cString session;
+  int streamId = -1, timeout = 0;
+  bool owner = false;
+  {
+    cMutexLock MutexLock(&mutexM);
+    cSatipShare *s = Find(keyP);
+    if (!s)
+       return false;
+    owner = (s->Owner() == &tunerP);
+    if (!s->Remove(tunerP))
+       return false;
+    if (!s->Count()) {
+       cMutexLock ListLock(&listMutexM);
+       sharesM.Del(s);
+       return false;
+       }
+    next = s->Owner();
+    session = s->GetSession();
+    streamId = s->GetStreamId();
+    timeout = s->GetTimeout();
+  }
+  // The tuners call in here with their own mutex released, so they're called the same way
+  if (owner) {
+     // Hand the session over to the next device instead of tearing it down
+     info("Handing the shared stream over to device %d [device %d]", next->GetId(), tunerP.GetId());
+     next->AdoptSession(*session, streamId, timeout);
+     }
+  next->UpdateSharedPids();
+  return owner;
+}
+
+void cSatipShares::SetPids(const char *keyP, cSatipTunerIf &tunerP, const char *pidsP)
+{
+  debug16("%s (%s, %s) [device %d]", __PRETTY_FUNCTION__, keyP, pidsP, tunerP.GetId());
+  cSatipTunerIf *owner = NULL;
+  {
+    cMutexLock MutexLock(&mutexM);
+    cSatipShare *s = Find(keyP);
+    if (s && s->SetPids(tunerP, pidsP))
+       owner = s->Owner();
+  }
+  // Let the owner update the union of the pids
+  if (owner)
+     owner->UpdateSharedPids();
+}
+
+cString cSatipShares::GetPids(const char *keyP)
+{
+  cMutexLock MutexLock(&mutexM);
+  cSatipShare *s = Find(keyP);
+  // Only the shared streams need the union
+  return (s && (s->Count() > 1)) ? s->GetPids() : cString("");
+}
+
+bool cSatipShares::IsReady(cSatipServer *serverP, int transponderP)
+{
+  debug16("%s (, %d)", __PRETTY_FUNCTION__, transponderP);
+  cMutexLock ListLock(&listMutexM);
+  for (cSatipShare *s = sharesM.First(); s; s = sharesM.Next(s)) {
+      if (s->Matches(serverP, transponderP) && s->IsReady())
+         return true;
+      }
+  return false;
+}
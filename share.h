@@ -0,0 +1,96 @@
+/*
+ * share.h: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __SATIP_SHARE_H
+#define __SATIP_SHARE_H
+
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+
+#include "common.h"
+#include "tunerif.h"
+
+class cSatipServer;
+
+// --- cSatipShare ------------------------------------------------------------
+
+// A multicast stream of a server, that is used by several devices. The owner
+// holds the RTSP session and the others just join the multicast group.
+class cSatipShare : public cListObject {
+private:
+  cString keyM;
+  cSatipServer *serverM;
+  int transponderM;
+  cSatipTunerIf *ownerM;
+  cVector<cSatipTunerIf *> membersM;
+  cString pidsM[SATIP_MAX_DEVICES]; // by the device index
+  bool readyM;
+  cString streamAddrM;
+  cString sourceAddrM;
+  int rtpPortM;
+  int rtcpPortM;
+  cString sessionM;
+  int streamIdM;
+  int timeoutM;
+
+public:
+  cSatipShare(const char *keyP, cSatipServer *serverP, int transponderP, cSatipTunerIf &ownerP);
+  virtual ~cSatipShare();
+  const char *Key(void) const { return *keyM; }
+  bool Matches(cSatipServer *serverP, int transponderP) const { return (serverM == serverP) && (transponderM == transponderP); }
+  cSatipTunerIf *Owner(void) { return ownerM; }
+  int Count(void) const { return membersM.Size(); }
+  bool IsReady(void) const { return readyM; }
+  bool Has(cSatipTunerIf &tunerP) const { return (membersM.IndexOf(&tunerP) >= 0); }
+  void Add(cSatipTunerIf &tunerP);
+  bool Remove(cSatipTunerIf &tunerP);
+  bool SetPids(cSatipTunerIf &tunerP, const char *pidsP);
+  cString GetPids(void);
+  void Publish(const char *streamAddrP, const char *sourceAddrP, int rtpPortP, int rtcpPortP, const char *sessionP, int streamIdP, int timeoutP);
+  void GetTransport(cString &streamAddrP, cString &sourceAddrP, int &rtpPortP, int &rtcpPortP);
+  cString GetSession(void) const { return sessionM; }
+  int GetStreamId(void) const { return streamIdM; }
+  int GetTimeout(void) const { return timeoutM; }
+};
+
+// --- cSatipShares -----------------------------------------------------------
+
+class cSatipShares {
+private:
+  static cSatipShares *instanceS;
+  cMutex mutexM;
+  // Guards the list and the readiness for the frontend assignment, which
+  // mustn't wait for the tuners
+  cMutex listMutexM;
+  cList<cSatipShare> sharesM;
+  cSatipShare *Find(const char *keyP);
+  // constructor
+  cSatipShares();
+  // to prevent copy constructor and assignment
+  cSatipShares(const cSatipShares&);
+  cSatipShares& operator=(const cSatipShares&);
+
+public:
+  enum eRole {
+    eShareNone = 0,
+    eShareOwner,
+    eShareFollower,
+    eSharePending
+  };
+  static cSatipShares *GetInstance(void);
+  static bool Initialize(void);
+  static void Destroy(void);
+  virtual ~cSatipShares();
+  int Join(const char *keyP, cSatipServer *serverP, int transponderP, cSatipTunerIf &tunerP, cString &streamAddrP, cString &sourceAddrP, int &rtpPortP, int &rtcpPortP);
+  void Publish(const char *keyP, cSatipTunerIf &tunerP, const char *streamAddrP, const char *sourceAddrP, int rtpPortP, int rtcpPortP, const char *sessionP, int streamIdP, int timeoutP);
+  bool Leave(const char *keyP, cSatipTunerIf &tunerP);
+  void SetPids(const char *keyP, cSatipTunerIf &tunerP, const char *pidsP);
+  cString GetPids(const char *keyP);
+  bool IsReady(cSatipServer *serverP, int transponderP);
+};
+
+#endif // __SATIP_SHARE_H
@@ -7,6 +7,8 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <netinet/udp.h>
+#include <linux/filter.h>
 #include <net/if.h>
 #include <netdb.h>
 #include <fcntl.h>
@@ -34,7 +36,10 @@ cSatipSocket::cSatipSocket()
   useSsmM(false),
   streamAddrM(htonl(INADDR_ANY)),
   sourceAddrM(htonl(INADDR_ANY)),
-  rcvBufSizeM(0)
+  rcvBufSizeM(0),
+  readTimeoutM(0),
+  useGroM(false),
+  groM(false)
 {
   debug1("%s", __PRETTY_FUNCTION__);
   memset(&sockAddrM, 0, sizeof(sockAddrM));
@@ -47,7 +52,10 @@ cSatipSocket::cSatipSocket(size_t rcvBufSizeP)
   useSsmM(false),
   streamAddrM(htonl(INADDR_ANY)),
   sourceAddrM(htonl(INADDR_ANY)),
-  rcvBufSizeM(rcvBufSizeP)
+  rcvBufSizeM(rcvBufSizeP),
+  readTimeoutM(0),
+  useGroM(false),
+  groM(false)
 {
   debug1("%s", __PRETTY_FUNCTION__);
   memset(&sockAddrM, 0, sizeof(sockAddrM));
@@ -92,6 +100,30 @@ bool cSatipSocket::Open(const int portP, const bool reuseP)
      ERROR_IF_FUNC(setsockopt(socketDescM, SOL_IP, IP_PKTINFO, &yes, sizeof(yes)) < 0,
                    "setsockopt(IP_PKTINFO)", Close(), return false);
 #endif // __FreeBSD__
+#ifdef SO_RXQ_OVFL
+     // Get the count of packets dropped by the kernel along with the data
+     yes = 1;
+     ERROR_IF(setsockopt(socketDescM, SOL_SOCKET, SO_RXQ_OVFL, &yes, sizeof(yes)) < 0, "setsockopt(SO_RXQ_OVFL)");
+#endif
+#ifdef SO_TIMESTAMPNS
+     // Get the kernel receive timestamps for the inter-arrival jitter
+     yes = 1;
+     ERROR_IF(setsockopt(socketDescM, SOL_SOCKET, SO_TIMESTAMPNS, &yes, sizeof(yes)) < 0, "setsockopt(SO_TIMESTAMPNS)");
+#endif
+     groM = false;
+     if (useGroM) {
+#ifdef UDP_GRO
+        // Let the kernel coalesce consecutive datagrams of a flow into a single read
+        yes = 1;
+        groM = (setsockopt(socketDescM, SOL_UDP, UDP_GRO, &yes, sizeof(yes)) == 0);
+#endif
+        if (!groM)
+           info("UDP GRO not supported by the kernel, using separate datagrams");
+        }
+     RestartSocketStatistic();
+     // Restore any read timeout into the new socket
+     if (readTimeoutM > 0)
+        SetReadTimeout(readTimeoutM);
      // Tweak receive buffer size if requested
      if (rcvBufSizeM > 0) {
         ERROR_IF_FUNC(setsockopt(socketDescM, SOL_SOCKET, SO_RCVBUF, &rcvBufSizeM, sizeof(rcvBufSizeM)) < 0,
@@ -117,7 +149,8 @@ bool cSatipSocket::Open(const int portP, const bool reuseP)
 bool cSatipSocket::OpenMulticast(const int portP, const char *streamAddrP, const char *sourceAddrP)
 {
   debug1("%s (%d, %s, %s)", __PRETTY_FUNCTION__, portP, streamAddrP, sourceAddrP);
-  if (Open(portP)) {
+  // Several devices may join the same shared stream
+  if (Open(portP, true)) {
      CheckAddress(streamAddrP, &streamAddrM);
      if (!isempty(sourceAddrP))
         useSsmM = CheckAddress(sourceAddrP, &sourceAddrM);
@@ -143,6 +176,95 @@ void cSatipSocket::Close(void)
      }
 }
 
+int cSatipSocket::GetRcvBufSize(void)
+{
+  int size = 0;
+  socklen_t len = sizeof(size);
+  if ((socketDescM < 0) || (getsockopt(socketDescM, SOL_SOCKET, SO_RCVBUF, &size, &len) < 0))
+     return -1;
+  return size;
+}
+
+bool cSatipSocket::SetReadTimeout(int timeoutMsP)
+{
+  debug1("%s (%d) socketPort=%d", __PRETTY_FUNCTION__, timeoutMsP, socketPortM);
+  readTimeoutM = max(timeoutMsP, 0);
+  if (socketDescM >= 0) {
+     // The batched reads may block up to the timeout, all other reads use MSG_DONTWAIT
+     struct timeval tv = { readTimeoutM / 1000, (readTimeoutM % 1000) * 1000 };
+     int flags = fcntl(socketDescM, F_GETFL);
+     ERROR_IF_RET(flags < 0, "fcntl(F_GETFL)", return false);
+     flags = readTimeoutM ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+     ERROR_IF_RET(fcntl(socketDescM, F_SETFL, flags) < 0, "fcntl(F_SETFL)", return false);
+     ERROR_IF_RET(setsockopt(socketDescM, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0, "setsockopt(SO_RCVTIMEO)", return false);
+     }
+  return true;
+}
+
+uint64_t cSatipSocket::ParseControl(struct msghdr *msghP, uint32_t &dropsP, bool &validP, unsigned int *segmentP)
+{
+  uint64_t arrival = 0;
+  validP = true;
+  if (segmentP)
+     *segmentP = 0;
+  // Process auxiliary received data
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msghP); cmsg != NULL; cmsg = CMSG_NXTHDR(msghP, cmsg)) {
+#ifdef SO_RXQ_OVFL
+      if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SO_RXQ_OVFL)) {
+         uint32_t drops;
+         memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+         if (drops > dropsP)
+            dropsP = drops;
+         }
+#endif
+#ifdef SCM_TIMESTAMPNS
+      if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_TIMESTAMPNS)) {
+         struct timespec ts;
+         memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+         arrival = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+         }
+#endif
+#ifdef UDP_GRO
+      if (segmentP && (cmsg->cmsg_level == SOL_UDP) && (cmsg->cmsg_type == UDP_GRO)) {
+         int segment;
+         memcpy(&segment, CMSG_DATA(cmsg), sizeof(segment));
+         *segmentP = (segment > 0) ? segment : 0;
+         }
+#endif
+#ifndef __FreeBSD__
+      // Validate the destination address of multicast streams
+      if (isMulticastM && (cmsg->cmsg_level == SOL_IP) && (cmsg->cmsg_type == IP_PKTINFO)) {
+         struct in_pktinfo *i = (struct in_pktinfo *)CMSG_DATA(cmsg);
+         validP = ((i->ipi_addr.s_addr == streamAddrM) || (htonl(INADDR_ANY) == streamAddrM));
+         }
+#endif // __FreeBSD__
+      }
+  return arrival;
+}
+
+bool cSatipSocket::Discard(void)
+{
+  debug1("%s socketPort=%d", __PRETTY_FUNCTION__, socketPortM);
+  // Keep the socket and its memberships, but drop all the data in the kernel
+  struct sock_filter code[] = { BPF_STMT(BPF_RET | BPF_K, 0) };
+  struct sock_fprog prog = { (unsigned short)ELEMENTS(code), code };
+  ERROR_IF_RET(socketDescM < 0, "Discard()", return false);
+  ERROR_IF_RET(setsockopt(socketDescM, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0, "setsockopt(SO_ATTACH_FILTER)", return false);
+  return true;
+}
+
+bool cSatipSocket::ProcessControl(struct msghdr *msghP, unsigned int *segmentP, uint64_t *arrivalP)
+{
+  // For the datagrams received outside of the read methods
+  uint32_t drops = 0;
+  bool valid;
+  uint64_t arrival = ParseControl(msghP, drops, valid, segmentP);
+  AddSocketStatistic(drops, &arrival, 1);
+  if (arrivalP)
+     *arrivalP = arrival;
+  return valid;
+}
+
 bool cSatipSocket::Flush(void)
 {
   debug1("%s", __PRETTY_FUNCTION__);
@@ -266,7 +388,7 @@ int cSatipSocket::Read(unsigned char *bufferAddrP, unsigned int bufferLenP)
     socklen_t addrlen = sizeof(sockAddrM);
     struct msghdr msgh;
     struct iovec iov;
-    char cbuf[256];
+    char cbuf[eControlSizeB];
     len = 0;
     // Initialize iov and msgh structures
     memset(&msgh, 0, sizeof(struct msghdr));
@@ -283,19 +405,13 @@ int cSatipSocket::Read(unsigned char *bufferAddrP, unsigned int bufferLenP)
     if (socketDescM && bufferAddrP && (bufferLenP > 0))
        len = (int)recvmsg(socketDescM, &msgh, MSG_DONTWAIT);
     if (len > 0) {
-#ifndef __FreeBSD__
-       if (isMulticastM) {
-          // Process auxiliary received data and validate source address
-          for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msgh); cmsg != NULL; cmsg = CMSG_NXTHDR(&msgh, cmsg)) {
-              if ((cmsg->cmsg_level == SOL_IP) && (cmsg->cmsg_type == IP_PKTINFO)) {
-                 struct in_pktinfo *i = (struct in_pktinfo *)CMSG_DATA(cmsg);
-                 if ((i->ipi_addr.s_addr == streamAddrM) || (htonl(INADDR_ANY) == streamAddrM))
-                    return len;
-                 }
-              }
-          }
-       else
-#endif // __FreeBSD__
+       uint32_t drops = 0;
+       bool valid;
+       uint64_t arrival = ParseControl(&msgh, drops, valid);
+       bool truncated = (msgh.msg_flags & MSG_TRUNC);
+       AddSocketStatistic(drops, &arrival, 1, truncated);
+       // Drop the datagrams that didn't fit into the buffer
+       if (valid && !truncated)
           return len;
        }
     } while (len > 0);
@@ -303,7 +419,7 @@ int cSatipSocket::Read(unsigned char *bufferAddrP, unsigned int bufferLenP)
   return 0;
 }
 
-int cSatipSocket::ReadMulti(unsigned char *bufferAddrP, unsigned int *elementRecvSizeP, unsigned int elementCountP, unsigned int elementBufferSizeP)
+int cSatipSocket::ReadMulti(unsigned char *bufferAddrP, unsigned int *elementRecvSizeP, unsigned int elementCountP, unsigned int elementBufferSizeP, unsigned int *elementSegmentSizeP, uint64_t *elementArrivalP)
 {
   debug16("%s (, , %d, %d)", __PRETTY_FUNCTION__, elementCountP, elementBufferSizeP);
   int count = -1;
@@ -320,19 +436,39 @@ int cSatipSocket::ReadMulti(unsigned char *bufferAddrP, unsigned int *elementRec
   // Initialize iov and msgh structures
   struct mmsghdr mmsgh[elementCountP];
   struct iovec iov[elementCountP];
+  char control[elementCountP][eControlSizeB];
+  uint64_t arrivals[elementCountP];
+  uint32_t drops = 0;
+  int truncated = 0;
   memset(mmsgh, 0, sizeof(mmsgh[0]) * elementCountP);
   for (unsigned int i = 0; i < elementCountP; ++i) {
       iov[i].iov_base = bufferAddrP + i * elementBufferSizeP;
       iov[i].iov_len = elementBufferSizeP;
       mmsgh[i].msg_hdr.msg_iov = &iov[i];
       mmsgh[i].msg_hdr.msg_iovlen = 1;
+      mmsgh[i].msg_hdr.msg_control = control[i];
+      mmsgh[i].msg_hdr.msg_controllen = eControlSizeB;
       }
 
-  // Read data from socket as a set
-  count = (int)recvmmsg(socketDescM, mmsgh, elementCountP, MSG_DONTWAIT, NULL);
+  // Read data from socket as a set, optionally waiting for the set to get filled
+  struct timespec timeout = { readTimeoutM / 1000, (readTimeoutM % 1000) * 1000000L };
+  count = (int)recvmmsg(socketDescM, mmsgh, elementCountP, readTimeoutM ? 0 : MSG_DONTWAIT, readTimeoutM ? &timeout : NULL);
   ERROR_IF_RET(count < 0 && errno != EAGAIN && errno != EWOULDBLOCK, "recvmmsg()", return -1);
-  for (int i = 0; i < count; ++i)
-      elementRecvSizeP[i] = mmsgh[i].msg_len;
+  for (int i = 0; i < count; ++i) {
+      bool valid;
+      // A zero segment size means a single datagram
+      arrivals[i] = ParseControl(&mmsgh[i].msg_hdr, drops, valid, elementSegmentSizeP ? &elementSegmentSizeP[i] : NULL);
+      // Report datagrams of other multicast groups and truncated ones as empty ones
+      if (valid && (mmsgh[i].msg_hdr.msg_flags & MSG_TRUNC)) {
+         valid = false;
+         truncated++;
+         }
+      elementRecvSizeP[i] = valid ? mmsgh[i].msg_len : 0;
+      if (elementArrivalP)
+         elementArrivalP[i] = arrivals[i];
+      }
+  if (count > 0)
+     AddSocketStatistic(drops, arrivals, count, truncated);
 #else
   count = 0;
   while (count < (int)elementCountP) {
@@ -341,6 +477,11 @@ int cSatipSocket::ReadMulti(unsigned char *bufferAddrP, unsigned int *elementRec
            return -1;
         else if (len == 0)
            break;
+        if (elementSegmentSizeP)
+           elementSegmentSizeP[count] = 0;
+        // The arrival time isn't available here
+        if (elementArrivalP)
+           elementArrivalP[count] = 0;
         elementRecvSizeP[count++] = len;
         }
 #endif
@@ -350,6 +491,81 @@ int cSatipSocket::ReadMulti(unsigned char *bufferAddrP, unsigned int *elementRec
 }
 
 
+int cSatipSocket::ReadMulti(unsigned char *headerAddrP, unsigned int headerLenP, unsigned char *bufferAddrP, unsigned int *elementRecvSizeP, unsigned int elementCountP, unsigned int elementBufferSizeP, uint64_t *elementArrivalP)
+{
+  debug16("%s (, %d, , , %d, %d)", __PRETTY_FUNCTION__, headerLenP, elementCountP, elementBufferSizeP);
+  int count = -1;
+  // Error out if socket not initialized
+  if (socketDescM <= 0) {
+     error("%s Invalid socket", __PRETTY_FUNCTION__);
+     return -1;
+     }
+  if (!headerAddrP || !headerLenP || !bufferAddrP || !elementRecvSizeP || !elementCountP || !elementBufferSizeP) {
+     error("%s Invalid parameter(s)", __PRETTY_FUNCTION__);
+     return -1;
+     }
+  // Scatter each datagram: the first headerLenP bytes into the header buffer
+  // and the rest straight into the given payload buffer
+  struct iovec iov[elementCountP][2];
+  for (unsigned int i = 0; i < elementCountP; ++i) {
+      iov[i][0].iov_base = headerAddrP + i * headerLenP;
+      iov[i][0].iov_len = headerLenP;
+      iov[i][1].iov_base = bufferAddrP + i * elementBufferSizeP;
+      iov[i][1].iov_len = elementBufferSizeP;
+      }
+  char control[elementCountP][eControlSizeB];
+  uint64_t arrivals[elementCountP];
+  uint32_t drops = 0;
+#ifndef __SATIP_DISABLE_RECVMMSG__
+  struct mmsghdr mmsgh[elementCountP];
+  memset(mmsgh, 0, sizeof(mmsgh[0]) * elementCountP);
+  for (unsigned int i = 0; i < elementCountP; ++i) {
+      mmsgh[i].msg_hdr.msg_iov = iov[i];
+      mmsgh[i].msg_hdr.msg_iovlen = 2;
+      mmsgh[i].msg_hdr.msg_control = control[i];
+      mmsgh[i].msg_hdr.msg_controllen = eControlSizeB;
+      }
+
+  // Read data from socket as a set
+  count = (int)recvmmsg(socketDescM, mmsgh, elementCountP, MSG_DONTWAIT, NULL);
+  ERROR_IF_RET(count < 0 && errno != EAGAIN && errno != EWOULDBLOCK, "recvmmsg()", return -1);
+  for (int i = 0; i < count; ++i) {
+      bool valid;
+      arrivals[i] = ParseControl(&mmsgh[i].msg_hdr, drops, valid);
+      // Report datagrams of other multicast groups as empty ones and truncated ones as longer than the buffers
+      elementRecvSizeP[i] = !valid ? 0 : (mmsgh[i].msg_hdr.msg_flags & MSG_TRUNC) ? headerLenP + elementBufferSizeP + 1 : mmsgh[i].msg_len;
+      }
+#else
+  count = 0;
+  while (count < (int)elementCountP) {
+        struct msghdr msgh;
+        bool valid;
+        memset(&msgh, 0, sizeof(msgh));
+        msgh.msg_iov = iov[count];
+        msgh.msg_iovlen = 2;
+        msgh.msg_control = control[count];
+        msgh.msg_controllen = eControlSizeB;
+        int len = (int)recvmsg(socketDescM, &msgh, MSG_DONTWAIT);
+        if (len < 0) {
+           ERROR_IF_RET(errno != EAGAIN && errno != EWOULDBLOCK, "recvmsg()", return -1);
+           break;
+           }
+        else if (len == 0)
+           break;
+        arrivals[count] = ParseControl(&msgh, drops, valid);
+        elementRecvSizeP[count++] = !valid ? 0 : (msgh.msg_flags & MSG_TRUNC) ? headerLenP + elementBufferSizeP + 1 : len;
+        }
+#endif
+  if (count > 0)
+     AddSocketStatistic(drops, arrivals, count);
+  if (elementArrivalP && (count > 0))
+     memcpy(elementArrivalP, arrivals, sizeof(arrivals[0]) * count);
+  debug16("%s Received %d packets size[0]=%d", __PRETTY_FUNCTION__, count, count > 0 ? elementRecvSizeP[0] : 0);
+
+  return count;
+}
+
+
 bool cSatipSocket::Write(const char *addrP, const unsigned char *bufferAddrP, unsigned int bufferLenP)
 {
   debug1("%s (%s, , %d)", __PRETTY_FUNCTION__, addrP, bufferLenP);
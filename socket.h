@@ -10,8 +10,14 @@
 
 #include <arpa/inet.h>
 
-class cSatipSocket {
+#include "common.h"
+#include "statistics.h"
+
+class cSatipSocket : public cSatipSocketStatistics {
 private:
+  enum {
+    eControlSizeB = 256
+  };
   int socketPortM;
   int socketDescM;
   struct sockaddr_in sockAddrM;
@@ -20,10 +26,14 @@ private:
   in_addr_t streamAddrM;
   in_addr_t sourceAddrM;
   size_t rcvBufSizeM;
+  int readTimeoutM;
+  bool useGroM;
+  bool groM;
 
   bool CheckAddress(const char *addrP, in_addr_t *inAddrP);
   bool Join(void);
   bool Leave(void);
+  uint64_t ParseControl(struct msghdr *msghP, uint32_t &dropsP, bool &validP, unsigned int *segmentP = NULL);
 
 public:
   cSatipSocket();
@@ -36,9 +46,16 @@ public:
   int Port(void) { return socketPortM; }
   bool IsMulticast(void) { return isMulticastM; }
   bool IsOpen(void) { return (socketDescM >= 0); }
+  int GetRcvBufSize(void);
+  bool SetReadTimeout(int timeoutMsP);
+  bool Discard(void);
+  void SetGro(bool onOffP) { useGroM = onOffP; }
+  bool HasGro(void) const { return groM; }
+  bool ProcessControl(struct msghdr *msghP, unsigned int *segmentP = NULL, uint64_t *arrivalP = NULL);
   bool Flush(void);
   int Read(unsigned char *bufferAddrP, unsigned int bufferLenP);
-  int ReadMulti(unsigned char *bufferAddrP, unsigned int *elementRecvSizeP, unsigned int elementCountP, unsigned int elementBufferSizeP);
+  int ReadMulti(unsigned char *bufferAddrP, unsigned int *elementRecvSizeP, unsigned int elementCountP, unsigned int elementBufferSizeP, unsigned int *elementSegmentSizeP = NULL, uint64_t *elementArrivalP = NULL);
+  int ReadMulti(unsigned char *headerAddrP, unsigned int headerLenP, unsigned char *bufferAddrP, unsigned int *elementRecvSizeP, unsigned int elementCountP, unsigned int elementBufferSizeP, uint64_t *elementArrivalP = NULL);
   bool Write(const char *addrP, const unsigned char *bufferAddrP, unsigned int bufferLenP);
 };
 
@@ -33,22 +33,22 @@ cString cSatipSectionStatistics::GetSectionStatistic()
   cMutexLock MutexLock(&mutexM);
   uint64_t elapsed = timerM.Elapsed(); /* in milliseconds */
   timerM.Set();
-  long bitrate = elapsed ? (long)(1000.0L * filteredDataM / KILOBYTE(1) / elapsed) : 0L;
+  long filteredData = __atomic_exchange_n(&filteredDataM, 0, __ATOMIC_RELAXED);
+  long numberOfCalls = __atomic_exchange_n(&numberOfCallsM, 0, __ATOMIC_RELAXED);
+  long bitrate = elapsed ? (long)(1000.0L * filteredData / KILOBYTE(1) / elapsed) : 0L;
   if (!SatipConfig.GetUseBytes())
      bitrate *= 8;
   // no trailing linefeed here!
-  cString s = cString::sprintf("%4ld (%4ld k%s/s)", numberOfCallsM, bitrate,
+  cString s = cString::sprintf("%4ld (%4ld k%s/s)", numberOfCalls, bitrate,
                                SatipConfig.GetUseBytes() ? "B" : "bit");
-  filteredDataM = numberOfCallsM = 0;
   return s;
 }
 
 void cSatipSectionStatistics::AddSectionStatistic(long bytesP, long callsP)
 {
   debug16("%s (%ld, %ld)", __PRETTY_FUNCTION__, bytesP, callsP);
-  cMutexLock MutexLock(&mutexM);
-  filteredDataM += bytesP;
-  numberOfCallsM += callsP;
+  __atomic_fetch_add(&filteredDataM, bytesP, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&numberOfCallsM, callsP, __ATOMIC_RELAXED);
 }
 
 // --- cSatipPidStatistics ----------------------------------------------------
@@ -59,11 +59,10 @@ cSatipPidStatistics::cSatipPidStatistics()
   mutexM()
 {
   debug1("%s", __PRETTY_FUNCTION__);
-  const int numberOfElements = sizeof(mostActivePidsM) / sizeof(pidStruct);
-  for (int i = 0; i < numberOfElements; ++i) {
-      mostActivePidsM[i].pid = -1;
-      mostActivePidsM[i].dataAmount = 0L;
-      }
+  memset(countersM, 0, sizeof(countersM));
+  memset(lastCountersM, 0, sizeof(lastCountersM));
+  for (int i = 0; i < MAXPID; ++i)
+      countersM[i].continuity = SATIP_NO_CONTINUITY;
 }
 
 cSatipPidStatistics::~cSatipPidStatistics()
@@ -75,61 +74,68 @@ cString cSatipPidStatistics::GetPidStatistic()
 {
   debug16("%s", __PRETTY_FUNCTION__);
   cMutexLock MutexLock(&mutexM);
-  const int numberOfElements = sizeof(mostActivePidsM) / sizeof(pidStruct);
+  const int numberOfElements = SATIP_STATS_ACTIVE_PIDS_COUNT;
+  int mostActivePids[numberOfElements];
+  unsigned long dataAmounts[numberOfElements];
+  int count = 0, pids = 0;
+  unsigned long packets = 0, ccErrors = 0;
   uint64_t elapsed = timerM.Elapsed(); /* in milliseconds */
   timerM.Set();
-  cString s("Active pids:\n");
-  for (int i = 0; i < numberOfElements; ++i) {
-      if (mostActivePidsM[i].pid >= 0) {
-         long bitrate = elapsed ? (long)(1000.0L * mostActivePidsM[i].dataAmount / KILOBYTE(1) / elapsed) : 0L;
-         if (!SatipConfig.GetUseBytes())
-            bitrate *= 8;
-         s = cString::sprintf("%sPid %d: %4d (%4ld k%s/s)\n", *s, i,
-                              mostActivePidsM[i].pid, bitrate,
-                              SatipConfig.GetUseBytes() ? "B" : "bit");
-         }
+  // Pick the most active pids of the period
+  for (int i = 0; i < MAXPID; ++i) {
+      unsigned long bytes = __atomic_load_n(&countersM[i].bytes, __ATOMIC_RELAXED);
+      unsigned long dataAmount = bytes - lastCountersM[i].bytes;
+      unsigned int n = __atomic_load_n(&countersM[i].packets, __ATOMIC_RELAXED);
+      packets += n - lastCountersM[i].packets;
+      ccErrors += __atomic_load_n(&countersM[i].ccErrors, __ATOMIC_RELAXED);
+      lastCountersM[i].bytes = bytes;
+      lastCountersM[i].packets = n;
+      if (!dataAmount)
+         continue;
+      ++pids;
+      count = InsertLargest(mostActivePids, dataAmounts, count, numberOfElements, i, dataAmount);
       }
-  for (int i = 0; i < numberOfElements; ++i) {
-      mostActivePidsM[i].pid = -1;
-      mostActivePidsM[i].dataAmount = 0L;
+  cString s("Active pids:\n");
+  for (int i = 0; i < count; ++i) {
+      long bitrate = elapsed ? (long)(1000.0L * dataAmounts[i] / KILOBYTE(1) / elapsed) : 0L;
+      if (!SatipConfig.GetUseBytes())
+         bitrate *= 8;
+      s = cString::sprintf("%sPid %d: %4d (%4ld k%s/s) cc errors: %u\n", *s, i,
+                           mostActivePids[i], bitrate,
+                           SatipConfig.GetUseBytes() ? "B" : "bit",
+                           __atomic_load_n(&countersM[mostActivePids[i]].ccErrors, __ATOMIC_RELAXED));
       }
+  s = cString::sprintf("%sTotal: %d pids, %lu packets, %lu cc errors\n", *s, pids, packets, ccErrors);
   return s;
 }
 
-int cSatipPidStatistics::SortPids(const void* data1P, const void* data2P)
+void cSatipPidStatistics::GetPidTotals(unsigned long &packetsP, unsigned long &ccErrorsP)
 {
   debug16("%s", __PRETTY_FUNCTION__);
-  const pidStruct *comp1 = reinterpret_cast<const pidStruct*>(data1P);
-  const pidStruct *comp2 = reinterpret_cast<const pidStruct*>(data2P);
-  if (comp1->dataAmount > comp2->dataAmount)
-     return -1;
-  if (comp1->dataAmount < comp2->dataAmount)
-     return 1;
-  return 0;
+  packetsP = ccErrorsP = 0;
+  for (int i = 0; i < MAXPID; ++i) {
+      packetsP += __atomic_load_n(&countersM[i].packets, __ATOMIC_RELAXED);
+      ccErrorsP += __atomic_load_n(&countersM[i].ccErrors, __ATOMIC_RELAXED);
+      }
 }
 
-void cSatipPidStatistics::AddPidStatistic(int pidP, long payloadP)
+void cSatipPidStatistics::AddPidStatistic(const uchar *dataP)
 {
-  debug16("%s (%d, %ld)", __PRETTY_FUNCTION__, pidP, payloadP);
-  cMutexLock MutexLock(&mutexM);
-  const int numberOfElements = sizeof(mostActivePidsM) / sizeof(pidStruct);
-  // If our statistic already is in the array, update it and quit
-  for (int i = 0; i < numberOfElements; ++i) {
-      if (mostActivePidsM[i].pid == pidP) {
-         mostActivePidsM[i].dataAmount += payloadP;
-         // Now re-sort the array and quit
-         qsort(mostActivePidsM, numberOfElements, sizeof(pidStruct), SortPids);
-         return;
-         }
-      }
-  // Apparently our pid isn't in the array. Replace the last element with this
-  // one if new payload is greater
-  if (mostActivePidsM[numberOfElements - 1].dataAmount < payloadP) {
-      mostActivePidsM[numberOfElements - 1].pid = pidP;
-      mostActivePidsM[numberOfElements - 1].dataAmount = payloadP;
-     // Re-sort
-     qsort(mostActivePidsM, numberOfElements, sizeof(pidStruct), SortPids);
-     }
+  debug16("%s", __PRETTY_FUNCTION__);
+  // The packets are delivered by a single thread, so plain stores will do
+  int pid = ts_pid(dataP);
+  pidCounter *c = &countersM[pid];
+  __atomic_store_n(&c->bytes, c->bytes + payload(dataP), __ATOMIC_RELAXED);
+  __atomic_store_n(&c->packets, c->packets + 1, __ATOMIC_RELAXED);
+  if (ts_continuity_error(dataP, c->continuity))
+     __atomic_store_n(&c->ccErrors, c->ccErrors + 1, __ATOMIC_RELAXED);
+}
+
+void cSatipPidStatistics::AddPidStatistics(const uchar *dataP, int countP)
+{
+  debug16("%s (, %d)", __PRETTY_FUNCTION__, countP);
+  for (int i = 0; i < countP; ++i, dataP += TS_SIZE)
+      AddPidStatistic(dataP);
 }
 
 // --- cSatipTunerStatistics --------------------------------------------------
@@ -137,6 +143,7 @@ void cSatipPidStatistics::AddPidStatistic(int pidP, long payloadP)
 // Tuner statistics class
 cSatipTunerStatistics::cSatipTunerStatistics()
 : dataBytesM(0),
+  lastDataBytesM(0),
   timerM(),
   mutexM()
 {
@@ -154,9 +161,11 @@ cString cSatipTunerStatistics::GetTunerStatistic()
   mutexM.Lock();
   uint64_t elapsed = timerM.Elapsed(); /* in milliseconds */
   timerM.Set();
-  long bitrate = elapsed ? (long)(1000.0L * dataBytesM / KILOBYTE(1) / elapsed) : 0L;
-  dataBytesM = 0;
+  unsigned long dataBytes = __atomic_load_n(&dataBytesM, __ATOMIC_RELAXED);
+  dataBytes -= lastDataBytesM;
+  lastDataBytesM += dataBytes;
   mutexM.Unlock();
+  long bitrate = elapsed ? (long)(1000.0L * dataBytes / KILOBYTE(1) / elapsed) : 0L;
 
   if (!SatipConfig.GetUseBytes())
      bitrate *= 8;
@@ -167,16 +176,86 @@ cString cSatipTunerStatistics::GetTunerStatistic()
 void cSatipTunerStatistics::AddTunerStatistic(long bytesP)
 {
   debug16("%s (%ld)", __PRETTY_FUNCTION__, bytesP);
+  // Called per received packet, the readers take the difference
+  __atomic_fetch_add(&dataBytesM, bytesP, __ATOMIC_RELAXED);
+}
+
+
+// --- cSatipSocketStatistics -------------------------------------------------
+
+// Socket statistics class
+cSatipSocketStatistics::cSatipSocketStatistics()
+: kernelDropsM(0),
+  truncatedM(0),
+  lastDropsM(0),
+  lastArrivalM(0),
+  intervalM(0),
+  jitterM(0),
+  mutexM()
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+}
+
+cSatipSocketStatistics::~cSatipSocketStatistics()
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+}
+
+cString cSatipSocketStatistics::GetSocketStatistic()
+{
+  debug16("%s", __PRETTY_FUNCTION__);
+  cMutexLock MutexLock(&mutexM);
+  return cString::sprintf("drops=%lu truncated=%lu interval=%.3f ms jitter=%.3f ms", kernelDropsM, truncatedM, intervalM / 1000000.0, jitterM / 1000000.0);
+}
+
+void cSatipSocketStatistics::AddSocketStatistic(uint32_t dropsP, const uint64_t *arrivalsP, int countP, int truncatedP)
+{
+  debug16("%s (%u, , %d, %d)", __PRETTY_FUNCTION__, dropsP, countP, truncatedP);
   cMutexLock MutexLock(&mutexM);
-  dataBytesM += bytesP;
+  if (truncatedP > 0)
+     truncatedM += truncatedP;
+  // The kernel reports the drops as a running counter of the socket
+  if (dropsP > lastDropsM) {
+     __atomic_store_n(&kernelDropsM, kernelDropsM + dropsP - lastDropsM, __ATOMIC_RELAXED);
+     lastDropsM = dropsP;
+     }
+  // Smoothed inter-arrival interval and its mean deviation in nanoseconds
+  for (int i = 0; arrivalsP && (i < countP); ++i) {
+      if (!arrivalsP[i])
+         continue;
+      if (lastArrivalM && (arrivalsP[i] >= lastArrivalM)) {
+         int64_t interval = (int64_t)(arrivalsP[i] - lastArrivalM);
+         int64_t deviation;
+         if (intervalM)
+            intervalM += (interval - intervalM) >> eSmoothingShift;
+         else
+            intervalM = interval;
+         deviation = interval - intervalM;
+         if (deviation < 0)
+            deviation = -deviation;
+         // The exporter reads it without locking
+         __atomic_store_n(&jitterM, jitterM + ((deviation - jitterM) >> eSmoothingShift), __ATOMIC_RELAXED);
+         }
+      lastArrivalM = arrivalsP[i];
+      }
 }
 
+void cSatipSocketStatistics::RestartSocketStatistic(void)
+{
+  debug16("%s", __PRETTY_FUNCTION__);
+  cMutexLock MutexLock(&mutexM);
+  // A new socket starts its counter from zero
+  lastDropsM = 0;
+  lastArrivalM = 0;
+}
 
 // Buffer statistics class
 cSatipBufferStatistics::cSatipBufferStatistics()
 : dataBytesM(0),
+  lastDataBytesM(0),
   freeSpaceM(0),
   usedSpaceM(0),
+  totalSpaceM(SATIP_BUFFER_SIZE),
   timerM(),
   mutexM()
 {
@@ -194,11 +273,15 @@ cString cSatipBufferStatistics::GetBufferStatistic()
   cMutexLock MutexLock(&mutexM);
   uint64_t elapsed = timerM.Elapsed(); /* in milliseconds */
   timerM.Set();
-  long bitrate = elapsed ? (long)(1000.0L * dataBytesM / KILOBYTE(1) / elapsed) : 0L;
-  long totalSpace = SATIP_BUFFER_SIZE;
-  float percentage = (float)((float)usedSpaceM / (float)totalSpace * 100.0);
+  unsigned long dataBytes = __atomic_load_n(&dataBytesM, __ATOMIC_RELAXED);
+  dataBytes -= lastDataBytesM;
+  lastDataBytesM += dataBytes;
+  long usedSpace = __atomic_exchange_n(&usedSpaceM, 0, __ATOMIC_RELAXED);
+  long bitrate = elapsed ? (long)(1000.0L * dataBytes / KILOBYTE(1) / elapsed) : 0L;
+  long totalSpace = max(totalSpaceM, 1L);
+  float percentage = (float)((float)usedSpace / (float)totalSpace * 100.0);
   long totalKilos = totalSpace / KILOBYTE(1);
-  long usedKilos = usedSpaceM / KILOBYTE(1);
+  long usedKilos = usedSpace / KILOBYTE(1);
   if (!SatipConfig.GetUseBytes()) {
      bitrate *= 8;
      totalKilos *= 8;
@@ -207,16 +290,15 @@ cString cSatipBufferStatistics::GetBufferStatistic()
   cString s = cString::sprintf("Buffer bitrate: %ld k%s/s\nBuffer usage: %ld/%ld k%s (%2.1f%%)\n", bitrate,
                                SatipConfig.GetUseBytes() ? "B" : "bit", usedKilos, totalKilos,
                                SatipConfig.GetUseBytes() ? "B" : "bit", percentage);
-  dataBytesM = 0;
-  usedSpaceM = 0;
   return s;
 }
 
 void cSatipBufferStatistics::AddBufferStatistic(long bytesP, long usedP)
 {
   debug16("%s (%ld, %ld)", __PRETTY_FUNCTION__, bytesP, usedP);
-  cMutexLock MutexLock(&mutexM);
-  dataBytesM += bytesP;
-  if (usedP > usedSpaceM)
-     usedSpaceM = usedP;
+  __atomic_fetch_add(&dataBytesM, bytesP, __ATOMIC_RELAXED);
+  // Keep the peak usage since the last read
+  long used = __atomic_load_n(&usedSpaceM, __ATOMIC_RELAXED);
+  while ((usedP > used) && !__atomic_compare_exchange_n(&usedSpaceM, &used, usedP, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
 }
@@ -8,6 +8,7 @@
 #ifndef __SATIP_STATISTICS_H
 #define __SATIP_STATISTICS_H
 
+#include <vdr/remux.h>
 #include <vdr/thread.h>
 
 // Section statistics
@@ -33,21 +34,28 @@ public:
   cSatipPidStatistics();
   virtual ~cSatipPidStatistics();
   cString GetPidStatistic();
+  void GetPidTotals(unsigned long &packetsP, unsigned long &ccErrorsP);
 
 protected:
-  void AddPidStatistic(int pidP, long payloadP);
+  void AddPidStatistic(const uchar *dataP);
+  void AddPidStatistics(const uchar *dataP, int countP);
 
 private:
-  struct pidStruct {
-    int  pid;
-    long dataAmount;
+  // Running counters, written only by the delivering thread
+  struct pidCounter {
+    unsigned long bytes;
+    unsigned int packets;
+    unsigned int ccErrors;
+    uint8_t continuity;
   };
-  pidStruct mostActivePidsM[SATIP_STATS_ACTIVE_PIDS_COUNT];
+  struct pidSnapshot {
+    unsigned long bytes;
+    unsigned int packets;
+  };
+  pidCounter countersM[MAXPID];
+  pidSnapshot lastCountersM[MAXPID];
   cTimeMs timerM;
   cMutex mutexM;
-
-private:
-  static int SortPids(const void* data1P, const void* data2P);
 };
 
 // Tuner statistics
@@ -56,30 +64,63 @@ public:
   cSatipTunerStatistics();
   virtual ~cSatipTunerStatistics();
   cString GetTunerStatistic();
+  unsigned long GetTunerBytes(void) { return __atomic_load_n(&dataBytesM, __ATOMIC_RELAXED); }
 
 protected:
   void AddTunerStatistic(long bytesP);
 
 private:
-  long dataBytesM;
+  // Running total, the reader keeps the value of the previous period
+  unsigned long dataBytesM;
+  unsigned long lastDataBytesM;
   cTimeMs timerM;
   cMutex mutexM;
 };
 
+// Socket statistics
+class cSatipSocketStatistics {
+public:
+  cSatipSocketStatistics();
+  virtual ~cSatipSocketStatistics();
+  cString GetSocketStatistic();
+  unsigned long GetKernelDrops(void) { return __atomic_load_n(&kernelDropsM, __ATOMIC_RELAXED); }
+  int64_t GetJitter(void) { return __atomic_load_n(&jitterM, __ATOMIC_RELAXED); }
+
+protected:
+  void AddSocketStatistic(uint32_t dropsP, const uint64_t *arrivalsP, int countP, int truncatedP = 0);
+  void RestartSocketStatistic(void);
+
+private:
+  enum {
+    eSmoothingShift = 4 // gain of 1/16 as in RFC 3550
+  };
+  unsigned long kernelDropsM;
+  unsigned long truncatedM;
+  uint32_t lastDropsM;
+  uint64_t lastArrivalM;
+  int64_t intervalM;
+  int64_t jitterM;
+  cMutex mutexM;
+};
+
 // Buffer statistics
 class cSatipBufferStatistics {
 public:
   cSatipBufferStatistics();
   virtual ~cSatipBufferStatistics();
   cString GetBufferStatistic();
+  unsigned long GetBufferBytes(void) { return __atomic_load_n(&dataBytesM, __ATOMIC_RELAXED); }
 
 protected:
+  void SetBufferSize(long sizeP) { totalSpaceM = sizeP; }
   void AddBufferStatistic(long bytesP, long usedP);
 
 private:
-  long dataBytesM;
+  unsigned long dataBytesM;
+  unsigned long lastDataBytesM;
   long freeSpaceM;
   long usedSpaceM;
+  long totalSpaceM;
   cTimeMs timerM;
   cMutex mutexM;
 };
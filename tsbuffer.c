@@ -0,0 +1,186 @@
+/*
+ * tsbuffer.c: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <vdr/device.h>
+
+#include "common.h"
+#include "log.h"
+#include "tsbuffer.h"
+
+cSatipTsBuffer::cSatipTsBuffer(int sizeP, const char *descriptionP)
+: bufferM(NULL),
+  packetsM(1),
+  maskM(0),
+  sizeM(0),
+  descriptionM(descriptionP),
+  ioThrottleM(),
+  readyM(),
+  headM(0),
+  overflowCountM(0),
+  overflowBytesM(0),
+  overflowsM(0),
+  lastOverflowReportM(),
+  partialLengthM(0),
+  tailM(0),
+  waitingM(0)
+{
+  debug1("%s (%d, %s)", __PRETTY_FUNCTION__, sizeP, descriptionP);
+  // Round the capacity up into a power of two packets, so at least the requested size is available
+  while (packetsM < (unsigned int)(sizeP / TS_SIZE))
+        packetsM <<= 1;
+  maskM = packetsM - 1;
+  bufferM = MALLOC(uchar, packetsM * TS_SIZE);
+  if (bufferM)
+     sizeM = packetsM * TS_SIZE;
+  else
+     error("Cannot create TS buffer: %s", *descriptionM);
+}
+
+cSatipTsBuffer::~cSatipTsBuffer()
+{
+  debug1("%s (%s)", __PRETTY_FUNCTION__, *descriptionM);
+  ioThrottleM.Release();
+  FREE_POINTER(bufferM);
+}
+
+void cSatipTsBuffer::Publish(unsigned int headP)
+{
+  __atomic_store_n(&headM, headP, __ATOMIC_RELEASE);
+  // Pairs with the consumer announcing itself before its final emptiness check
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&waitingM, __ATOMIC_RELAXED))
+     readyM.Signal();
+  if ((int)(100LL * (headP - __atomic_load_n(&tailM, __ATOMIC_ACQUIRE)) / packetsM) >= eIoThrottleHighPercent)
+     ioThrottleM.Activate();
+}
+
+void cSatipTsBuffer::Clear(void)
+{
+  // Only the consumer may move the tail, so drop everything by catching up with the head
+  __atomic_store_n(&tailM, __atomic_load_n(&headM, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+  ioThrottleM.Release();
+}
+
+uchar *cSatipTsBuffer::Get(int &countP)
+{
+  countP = 0;
+  if (!bufferM)
+     return NULL;
+  unsigned int tail = __atomic_load_n(&tailM, __ATOMIC_RELAXED);
+  unsigned int used = __atomic_load_n(&headM, __ATOMIC_ACQUIRE) - tail;
+  if (!used) {
+     // Avoid a busy loop in the consumer
+     __atomic_store_n(&waitingM, 1, __ATOMIC_RELAXED);
+     __atomic_thread_fence(__ATOMIC_SEQ_CST);
+     used = __atomic_load_n(&headM, __ATOMIC_ACQUIRE) - tail;
+     if (!used) {
+        readyM.Wait(eGetTimeoutMs);
+        used = __atomic_load_n(&headM, __ATOMIC_ACQUIRE) - tail;
+        }
+     __atomic_store_n(&waitingM, 0, __ATOMIC_RELAXED);
+     }
+  // Hand out the whole contiguous run of packets at once
+  unsigned int slot = tail & maskM;
+  countP = min(used, packetsM - slot) * TS_SIZE;
+  return (countP > 0) ? bufferM + slot * TS_SIZE : NULL;
+}
+
+void cSatipTsBuffer::Del(int countP)
+{
+  unsigned int tail = __atomic_load_n(&tailM, __ATOMIC_RELAXED);
+  unsigned int used = __atomic_load_n(&headM, __ATOMIC_ACQUIRE) - tail;
+  unsigned int packets = min((unsigned int)(countP > 0 ? countP / TS_SIZE : 0), used);
+  if (packets > 0) {
+     __atomic_store_n(&tailM, tail + packets, __ATOMIC_RELEASE);
+     if ((int)(100LL * (used - packets) / packetsM) < eIoThrottleLowPercent)
+        ioThrottleM.Release();
+     }
+}
+
+uchar *cSatipTsBuffer::GetWriteSpace(int &countP)
+{
+  // The free space may be written freely, as the consumer never touches it before Commit()
+  unsigned int head = __atomic_load_n(&headM, __ATOMIC_RELAXED);
+  unsigned int room = packetsM - (head - __atomic_load_n(&tailM, __ATOMIC_ACQUIRE));
+  unsigned int slot = head & maskM;
+  countP = bufferM ? min(room, packetsM - slot) * TS_SIZE : 0;
+  return (countP > 0) ? bufferM + slot * TS_SIZE : NULL;
+}
+
+bool cSatipTsBuffer::Commit(const uchar *dataP, int countP)
+{
+  unsigned int head = __atomic_load_n(&headM, __ATOMIC_RELAXED);
+  unsigned int room = packetsM - (head - __atomic_load_n(&tailM, __ATOMIC_ACQUIRE));
+  unsigned int slot = head & maskM;
+  unsigned int packets = countP / TS_SIZE;
+  // Reject stale pointers and anything not fitting into the contiguous space
+  if (!bufferM || (dataP != bufferM + slot * TS_SIZE) || (countP % TS_SIZE) || (packets > min(room, packetsM - slot))) {
+     debug16("%s (, %d) Rejected [%s]", __PRETTY_FUNCTION__, countP, *descriptionM);
+     return false;
+     }
+  // The received data starts a new packet, so the one left over from Put() can't be completed anymore
+  partialLengthM = 0;
+  if (packets > 0)
+     Publish(head + packets);
+  return true;
+}
+
+unsigned int cSatipTsBuffer::Store(const uchar *dataP, unsigned int packetsP)
+{
+  unsigned int head = __atomic_load_n(&headM, __ATOMIC_RELAXED);
+  unsigned int room = packetsM - (head - __atomic_load_n(&tailM, __ATOMIC_ACQUIRE));
+  unsigned int packets = min(packetsP, room);
+  if (packets > 0) {
+     unsigned int slot = head & maskM;
+     unsigned int len = min(packets, packetsM - slot);
+     memcpy(bufferM + slot * TS_SIZE, dataP, len * TS_SIZE);
+     if (len < packets)
+        memcpy(bufferM, dataP + len * TS_SIZE, (packets - len) * TS_SIZE);
+     Publish(head + packets);
+     }
+  return packets;
+}
+
+int cSatipTsBuffer::Put(const uchar *dataP, int countP)
+{
+  if (!bufferM || !dataP || (countP <= 0))
+     return 0;
+  int count = countP, dropped = 0;
+  // Complete the packet left over from the previous call first
+  if (partialLengthM > 0) {
+     int len = min(count, TS_SIZE - partialLengthM);
+     memcpy(partialM + partialLengthM, dataP, len);
+     partialLengthM += len;
+     if (partialLengthM < TS_SIZE)
+        return countP;
+     partialLengthM = 0;
+     if (!Store(partialM, 1))
+        dropped += len;
+     dataP += len;
+     count -= len;
+     }
+  unsigned int packets = count / TS_SIZE;
+  dropped += (packets - Store(dataP, packets)) * TS_SIZE;
+  // Carry the trailing partial packet over to the next call
+  partialLengthM = count % TS_SIZE;
+  if (partialLengthM > 0)
+     memcpy(partialM, dataP + packets * TS_SIZE, partialLengthM);
+  return countP - dropped;
+}
+
+void cSatipTsBuffer::ReportOverflow(int bytesP)
+{
+  // Called only by the producer
+  __atomic_store_n(&overflowsM, overflowsM + 1, __ATOMIC_RELAXED);
+  overflowCountM++;
+  overflowBytesM += bytesP;
+  if (lastOverflowReportM.Elapsed() > eOverflowReportTimeoutMs) {
+     error("%d TS buffer overflow%s (%d bytes dropped) [%s]", overflowCountM, overflowCountM > 1 ? "s" : "", overflowBytesM, *descriptionM);
+     overflowCountM = overflowBytesM = 0;
+     lastOverflowReportM.Set();
+     }
+}
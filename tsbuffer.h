@@ -0,0 +1,81 @@
+/*
+ * tsbuffer.h: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __SATIP_TSBUFFER_H
+#define __SATIP_TSBUFFER_H
+
+#include <vdr/remux.h>
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+
+#define SATIP_CACHE_LINE_SIZE 64
+
+// Lock-free single-producer/single-consumer ring buffer of whole TS packets.
+// The capacity is the smallest power of two in packets that holds the
+// requested size, so the free-running head and tail packet counters can be
+// masked into slots. The producer owns the head, the consumer owns the tail,
+// and both are published with release stores and read with acquire loads.
+// Unlike cRingBufferLinear, it exposes its contiguous free space, so the
+// producer can receive data directly into it. A trailing partial packet
+// given to Put() is carried over and completed by the next call.
+class cSatipTsBuffer {
+private:
+  enum {
+    eGetTimeoutMs            = 10,   // in milliseconds
+    eOverflowReportTimeoutMs = 5000, // in milliseconds
+    eIoThrottleLowPercent    = 20,
+    eIoThrottleHighPercent   = 50
+  };
+  // Read-mostly data shared by both sides
+  uchar *bufferM;
+  unsigned int packetsM;
+  unsigned int maskM;
+  int sizeM;
+  cString descriptionM;
+  cIoThrottle ioThrottleM;
+  cCondWait readyM;
+  // Producer side
+  char producerPadM[SATIP_CACHE_LINE_SIZE];
+  unsigned int headM;
+  int overflowCountM;
+  int overflowBytesM;
+  unsigned long overflowsM;
+  cTimeMs lastOverflowReportM;
+  uchar partialM[TS_SIZE];
+  int partialLengthM;
+  // Consumer side
+  char consumerPadM[SATIP_CACHE_LINE_SIZE];
+  unsigned int tailM;
+  int waitingM;
+  char endPadM[SATIP_CACHE_LINE_SIZE];
+  unsigned int Used(void) const { return __atomic_load_n(&headM, __ATOMIC_ACQUIRE) - __atomic_load_n(&tailM, __ATOMIC_ACQUIRE); }
+  void Publish(unsigned int headP);
+  unsigned int Store(const uchar *dataP, unsigned int packetsP);
+
+  // to prevent copy constructor and assignment
+  cSatipTsBuffer(const cSatipTsBuffer&);
+  cSatipTsBuffer& operator=(const cSatipTsBuffer&);
+
+public:
+  cSatipTsBuffer(int sizeP, const char *descriptionP);
+  virtual ~cSatipTsBuffer();
+  int Size(void) const { return sizeM; }
+  int Available(void) const { return Used() * TS_SIZE; }
+  int Free(void) const { return sizeM - Available(); }
+  unsigned long Overflows(void) const { return __atomic_load_n(&overflowsM, __ATOMIC_RELAXED); }
+  // consumer side
+  void Clear(void);
+  uchar *Get(int &countP);
+  void Del(int countP);
+  // producer side
+  uchar *GetWriteSpace(int &countP);
+  bool Commit(const uchar *dataP, int countP);
+  int Put(const uchar *dataP, int countP);
+  void ReportOverflow(int bytesP);
+};
+
+#endif // __SATIP_TSBUFFER_H
@@ -0,0 +1,376 @@
+/*
+ * tsmonitor.c: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#define __STDC_FORMAT_MACROS // Required for format specifiers
+#include <inttypes.h>
+#include <time.h>
+
+#include "common.h"
+#include "config.h"
+#include "log.h"
+#include "tsmonitor.h"
+
+cSatipTsMonitor::cSatipTsMonitor()
+: tableCountM(0),
+  patVersionM(-1),
+  mutexM(),
+  pcrM(SatipConfig.GetPcrAnalysis()),
+  syncM(false),
+  syncGoodM(0),
+  syncBadM(0),
+  resetM(false),
+  packetsM(0),
+  syncLossM(0),
+  syncByteErrorsM(0),
+  ccErrorsM(0),
+  patErrorsM(0),
+  pmtErrorsM(0),
+  transportErrorsM(0)
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+  memset(requestedM, 0, sizeof(requestedM));
+  memset(servicesM, 0, sizeof(servicesM));
+  Clear();
+}
+
+cSatipTsMonitor::~cSatipTsMonitor()
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+}
+
+void cSatipTsMonitor::Clear(void)
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+  memset(pidsM, 0, sizeof(pidsM));
+  memset(tablesM, 0, sizeof(tablesM));
+  for (int i = 0; i < MAXPID; ++i)
+      pidsM[i].continuity = SATIP_NO_CONTINUITY;
+  // The PAT is always the first table
+  tablesM[0].pid = 0;
+  pidsM[0].table = 1;
+  __atomic_store_n(&tableCountM, 1, __ATOMIC_RELAXED);
+  patVersionM = -1;
+  __atomic_store_n(&syncM, false, __ATOMIC_RELAXED);
+  syncGoodM = syncBadM = 0;
+  __atomic_store_n(&packetsM, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&syncLossM, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&syncByteErrorsM, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&ccErrorsM, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&patErrorsM, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&pmtErrorsM, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&transportErrorsM, 0, __ATOMIC_RELAXED);
+  ClearServices();
+}
+
+void cSatipTsMonitor::ClearServices(void)
+{
+  debug16("%s", __PRETTY_FUNCTION__);
+  cMutexLock MutexLock(&mutexM);
+  for (int i = 0; i < eMaxTables; ++i) {
+      servicesM[i].version = -1;
+      servicesM[i].hasPcr = false;
+      servicesM[i].count = 0;
+      }
+}
+
+void cSatipTsMonitor::Reset(void)
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+  // The state belongs to the receiving thread, so it's cleared on the next batch
+  __atomic_store_n(&resetM, true, __ATOMIC_RELEASE);
+}
+
+void cSatipTsMonitor::SetPid(int pidP, bool onP)
+{
+  debug16("%s (%d, %d)", __PRETTY_FUNCTION__, pidP, onP);
+  if ((pidP < 0) || (pidP >= MAXPID))
+     return;
+  if (onP)
+     __atomic_fetch_or(&requestedM[pidP / 32], 1U << (pidP % 32), __ATOMIC_RELAXED);
+  else
+     __atomic_fetch_and(&requestedM[pidP / 32], ~(1U << (pidP % 32)), __ATOMIC_RELAXED);
+}
+
+void cSatipTsMonitor::CheckTimeouts(uint64_t nowP)
+{
+  debug16("%s", __PRETTY_FUNCTION__);
+  for (int i = 0; i < tableCountM; ++i) {
+      tableState *t = &tablesM[i];
+      if (!t->deadline || (nowP <= t->deadline))
+         continue;
+      // The server delivers only the requested pids, so a table dropped from
+      // the request isn't repeated anymore and it's just forgotten
+      if (!(__atomic_load_n(&requestedM[t->pid / 32], __ATOMIC_RELAXED) & (1U << (t->pid % 32)))) {
+         t->deadline = 0;
+         continue;
+         }
+      Increment(i ? pmtErrorsM : patErrorsM);
+      t->deadline = nowP + eTableTimeoutMs;
+      }
+}
+
+void cSatipTsMonitor::ParsePat(const uint8_t *sectionP, int lengthP)
+{
+  debug16("%s (, %d)", __PRETTY_FUNCTION__, lengthP);
+  if ((lengthP < 8) || !(sectionP[5] & 0x01)) // too short or not yet applicable?
+     return;
+  int version = (sectionP[5] >> 1) & 0x1F;
+  int end = min(3 + (((sectionP[1] & 0x0F) << 8) | sectionP[2]) - 4, lengthP);
+  // A new version replaces the referred PMTs and their services
+  if (version != patVersionM) {
+     for (int i = 1; i < tableCountM; ++i)
+         pidsM[tablesM[i].pid].table = 0;
+     if (pcrM) {
+        for (int i = 0; i < MAXPID; ++i)
+            pidsM[i].service = 0;
+        ClearServices();
+        }
+     __atomic_store_n(&tableCountM, 1, __ATOMIC_RELAXED);
+     patVersionM = version;
+     }
+  for (int i = 8; i + 4 <= end; i += 4) {
+      int program = (sectionP[i] << 8) | sectionP[i + 1];
+      int pid = ((sectionP[i + 2] & 0x1F) << 8) | sectionP[i + 3];
+      if (!program || pidsM[pid].table) // network information or already known?
+         continue;
+      if (tableCountM >= eMaxTables)
+         break;
+      tablesM[tableCountM].pid = (uint16_t)pid;
+      tablesM[tableCountM].deadline = 0;
+      pidsM[pid].table = (uint8_t)(tableCountM + 1);
+      __atomic_store_n(&tableCountM, tableCountM + 1, __ATOMIC_RELAXED);
+      }
+}
+
+void cSatipTsMonitor::ParsePmt(const uint8_t *sectionP, int lengthP, int indexP)
+{
+  debug16("%s (, %d, %d)", __PRETTY_FUNCTION__, lengthP, indexP);
+  if ((lengthP < 12) || !(sectionP[5] & 0x01)) // too short or not yet applicable?
+     return;
+  serviceState *v = &servicesM[indexP];
+  int version = (sectionP[5] >> 1) & 0x1F;
+  if (version == v->version)
+     return;
+  int end = min(3 + (((sectionP[1] & 0x0F) << 8) | sectionP[2]) - 4, lengthP);
+  cMutexLock MutexLock(&mutexM);
+  if (v->version >= 0) {
+     for (int i = 0; i < MAXPID; ++i) {
+         if (pidsM[i].service == indexP)
+            pidsM[i].service = 0;
+         }
+     }
+  v->program = (sectionP[3] << 8) | sectionP[4];
+  v->pcrPid = ((sectionP[8] & 0x1F) << 8) | sectionP[9];
+  v->version = version;
+  v->hasPcr = false;
+  v->count = 0;
+  // The PMT, PCR and elementary stream pids make up the service; a shared
+  // pid is counted only into the first service
+  if (!pidsM[tablesM[indexP].pid].service)
+     pidsM[tablesM[indexP].pid].service = (uint8_t)indexP;
+  if ((v->pcrPid != 0x1FFF) && !pidsM[v->pcrPid].service)
+     pidsM[v->pcrPid].service = (uint8_t)indexP;
+  for (int i = 12 + (((sectionP[10] & 0x0F) << 8) | sectionP[11]); i + 5 <= end; i += 5 + (((sectionP[i + 3] & 0x0F) << 8) | sectionP[i + 4])) {
+      int pid = ((sectionP[i + 1] & 0x1F) << 8) | sectionP[i + 2];
+      if (!pidsM[pid].service)
+         pidsM[pid].service = (uint8_t)indexP;
+      }
+  debug6("%s Service %d with pcr pid %d [pmt %d]", __PRETTY_FUNCTION__, v->program, v->pcrPid, tablesM[indexP].pid);
+}
+
+void cSatipTsMonitor::ProcessPcr(int indexP, uint64_t pcrP, bool discontinuityP, int64_t nowNsP)
+{
+  debug16("%s (%d, %" PRIu64 ", %d)", __PRETTY_FUNCTION__, indexP, pcrP, discontinuityP);
+  const uint64_t pcrWrap = 0x200000000ULL * 300;
+  serviceState *v = &servicesM[indexP];
+  uint64_t delta = v->hasPcr ? (pcrP + pcrWrap - v->lastPcr) % pcrWrap : 0;
+  if (!discontinuityP && delta && (delta <= (uint64_t)eMaxPcrGapMs * 27000)) {
+     // The arrival time is compared against the time predicted by the PCRs and
+     // the smoothed offset follows the drift between the clocks
+     v->pcrClockNs += (int64_t)(delta * 1000 / 27);
+     int64_t jitter = (nowNsP - v->pcrClockNs) - v->offsetNs;
+     v->offsetNs += jitter / eJitterSmoothing;
+     cMutexLock MutexLock(&mutexM);
+     unsigned int n = v->count % eMaxSamples;
+     v->intervalUs[n] = (int)(delta / 27);
+     v->jitterUs[n] = (int)(llabs(jitter) / 1000);
+     v->bitrate[n] = (int)((uint64_t)v->packets * TS_SIZE * 8 * 27000 / delta);
+     v->muxBitrate[n] = (int)((uint64_t)(packetsM - v->muxPackets) * TS_SIZE * 8 * 27000 / delta);
+     v->count++;
+     }
+  else {
+     // Start over from a discontinuity or from a gap in the stream
+     v->hasPcr = true;
+     v->pcrClockNs = nowNsP;
+     v->offsetNs = 0;
+     }
+  v->lastPcr = pcrP;
+  v->packets = 0;
+  v->muxPackets = packetsM;
+}
+
+void cSatipTsMonitor::AnalyzePacket(const uint8_t *dataP, uint64_t nowMsP, int64_t arrivalNsP)
+{
+  debug16("%s", __PRETTY_FUNCTION__);
+  Increment(packetsM);
+  // Nothing else is trusted in a packet flagged by the demodulator
+  if (dataP[1] & 0x80) {
+     Increment(transportErrorsM);
+     return;
+     }
+  int pid = ts_pid(dataP);
+  pidState *s = &pidsM[pid];
+  if (ts_continuity_error(dataP, s->continuity)) {
+     Increment(ccErrorsM);
+     if (s->ccErrors < 0xFFFF)
+        __atomic_store_n(&s->ccErrors, s->ccErrors + 1, __ATOMIC_RELAXED);
+     }
+  if (pcrM && s->service) {
+     ++servicesM[s->service].packets;
+     if ((pid == servicesM[s->service].pcrPid) && ts_has_pcr(dataP))
+        ProcessPcr(s->service, ts_pcr(dataP), ts_discontinuity(dataP), arrivalNsP);
+     }
+  if (!s->table)
+     return;
+  bool pat = (s->table == 1);
+  tableState *t = &tablesM[s->table - 1];
+  if (dataP[3] & 0xC0) { // scrambled table?
+     Increment(pat ? patErrorsM : pmtErrorsM);
+     return;
+     }
+  if (!(dataP[1] & 0x40) || !(dataP[3] & 0x10)) // no section start?
+     return;
+  int offset = 4;
+  if (dataP[3] & 0x20)
+     offset += 1 + dataP[4];
+  if (offset >= TS_SIZE)
+     return;
+  offset += 1 + dataP[offset]; // pointer field
+  if (offset >= TS_SIZE)
+     return;
+  if (pat) {
+     if (dataP[offset] != 0x00) {
+        Increment(patErrorsM);
+        return;
+        }
+     ParsePat(dataP + offset, TS_SIZE - offset);
+     }
+  else if (dataP[offset] != 0x02)
+     return;
+  else if (pcrM)
+     ParsePmt(dataP + offset, TS_SIZE - offset, s->table - 1);
+  t->deadline = nowMsP + eTableTimeoutMs;
+}
+
+void cSatipTsMonitor::Analyze(const uint8_t *dataP, int lengthP, uint64_t arrivalP)
+{
+  debug16("%s (, %d, %" PRIu64 ")", __PRETTY_FUNCTION__, lengthP, arrivalP);
+  if (__atomic_exchange_n(&resetM, false, __ATOMIC_ACQUIRE))
+     Clear();
+  // The payload of a single datagram shares the arrival time given by the kernel
+  uint64_t now = cTimeMs::Now();
+  if (!arrivalP) {
+     struct timespec ts;
+     clock_gettime(CLOCK_REALTIME, &ts);
+     arrivalP = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+     }
+  for (; lengthP >= TS_SIZE; dataP += TS_SIZE, lengthP -= TS_SIZE) {
+      if (dataP[0] != TS_SYNC_BYTE) {
+         Increment(syncByteErrorsM);
+         syncGoodM = 0;
+         if ((++syncBadM >= eSyncLose) && syncM) {
+            __atomic_store_n(&syncM, false, __ATOMIC_RELAXED);
+            Increment(syncLossM);
+            }
+         continue;
+         }
+      syncBadM = 0;
+      if (!syncM) {
+         if (++syncGoodM < eSyncAcquire)
+            continue;
+         __atomic_store_n(&syncM, true, __ATOMIC_RELAXED);
+         }
+      AnalyzePacket(dataP, now, (int64_t)arrivalP);
+      }
+  CheckTimeouts(now);
+}
+
+cString cSatipTsMonitor::GetInformation(void)
+{
+  debug16("%s", __PRETTY_FUNCTION__);
+  const int numberOfElements = SATIP_STATS_ACTIVE_PIDS_COUNT;
+  int pids[numberOfElements];
+  unsigned long errors[numberOfElements];
+  int count = 0;
+  // Pick the pids with the most continuity errors
+  for (int i = 0; i < MAXPID; ++i) {
+      unsigned int n = __atomic_load_n(&pidsM[i].ccErrors, __ATOMIC_RELAXED);
+      if (n)
+         count = InsertLargest(pids, errors, count, numberOfElements, i, n);
+      }
+  cString s = cString::sprintf("TR 101 290 priority 1:\n"
+                               "TS sync: %s, sync loss: %lu, sync byte errors: %lu\n"
+                               "PAT errors: %lu\n"
+                               "PMT errors: %lu (%d pmts)\n"
+                               "Continuity count errors: %lu\n"
+                               "Transport errors: %lu\n"
+                               "Packets: %lu\n",
+                               __atomic_load_n(&syncM, __ATOMIC_RELAXED) ? "yes" : "no",
+                               __atomic_load_n(&syncLossM, __ATOMIC_RELAXED),
+                               __atomic_load_n(&syncByteErrorsM, __ATOMIC_RELAXED),
+                               __atomic_load_n(&patErrorsM, __ATOMIC_RELAXED),
+                               __atomic_load_n(&pmtErrorsM, __ATOMIC_RELAXED),
+                               __atomic_load_n(&tableCountM, __ATOMIC_RELAXED) - 1,
+                               __atomic_load_n(&ccErrorsM, __ATOMIC_RELAXED),
+                               __atomic_load_n(&transportErrorsM, __ATOMIC_RELAXED),
+                               __atomic_load_n(&packetsM, __ATOMIC_RELAXED));
+  if (count) {
+     s = cString::sprintf("%sContinuity count errors per pid:\n", *s);
+     for (int i = 0; i < count; ++i)
+         s = cString::sprintf("%sPid %d: %4d (%lu)\n", *s, i, pids[i], errors[i]);
+     }
+  return s;
+}
+
+int cSatipTsMonitor::SortSamples(const void *data1P, const void *data2P)
+{
+  return (*(const int *)data1P - *(const int *)data2P);
+}
+
+cString cSatipTsMonitor::GetPercentiles(const char *nameP, const int *samplesP, int countP, int divisorP, const char *unitP)
+{
+  int samples[eMaxSamples];
+  memcpy(samples, samplesP, countP * sizeof(int));
+  qsort(samples, countP, sizeof(int), SortSamples);
+  // nearest-rank percentiles
+  return cString::sprintf("%-8s %7d %7d %7d %7d [%s]\n", nameP,
+                          samples[(50 * countP + 99) / 100 - 1] / divisorP, samples[(95 * countP + 99) / 100 - 1] / divisorP,
+                          samples[(99 * countP + 99) / 100 - 1] / divisorP, samples[countP - 1] / divisorP, unitP);
+}
+
+cString cSatipTsMonitor::GetPcrInformation(void)
+{
+  debug16("%s", __PRETTY_FUNCTION__);
+  if (!pcrM)
+     return "PCR analysis not enabled\n";
+  int divisor = SatipConfig.GetUseBytes() ? 8 : 1;
+  const char *unit = SatipConfig.GetUseBytes() ? "kB/s" : "kbit/s";
+  cMutexLock MutexLock(&mutexM);
+  cString s = "";
+  for (int i = 1; i < __atomic_load_n(&tableCountM, __ATOMIC_RELAXED); ++i) {
+      serviceState *v = &servicesM[i];
+      if (!v->count)
+         continue;
+      int n = min(v->count, (unsigned int)eMaxSamples);
+      s = cString::sprintf("%sService %d (pcr pid %d, %u pcrs)\n%-8s %7s %7s %7s %7s\n", *s, v->program, v->pcrPid, v->count, "", "p50", "p95", "p99", "max");
+      s = cString::sprintf("%s%s", *s, *GetPercentiles("Interval", v->intervalUs, n, 1, "us"));
+      s = cString::sprintf("%s%s", *s, *GetPercentiles("Jitter", v->jitterUs, n, 1, "us"));
+      s = cString::sprintf("%s%s", *s, *GetPercentiles("Bitrate", v->bitrate, n, divisor, unit));
+      s = cString::sprintf("%s%s", *s, *GetPercentiles("Mux", v->muxBitrate, n, divisor, unit));
+      }
+  return isempty(*s) ? cString("No PCRs received\n") : s;
+}
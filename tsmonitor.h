@@ -0,0 +1,101 @@
+/*
+ * tsmonitor.h: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __SATIP_TSMONITOR_H
+#define __SATIP_TSMONITOR_H
+
+#include <vdr/remux.h>
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+
+#include "common.h"
+
+// Transport stream monitor for the priority 1 checks of ETSI TR 101 290:
+// the received packets are analyzed in batches by the receiving thread and
+// the counters are only read by the others. Optionally, the PCRs of the
+// services are followed for their interval, jitter and bitrate.
+class cSatipTsMonitor {
+private:
+  enum {
+    eSyncAcquire      = 5,     // consecutive sync bytes to acquire the sync
+    eSyncLose         = 2,     // consecutive corrupted sync bytes to lose it
+    eMaxTables        = 64,    // PAT and the PMTs referred by it
+    eTableTimeoutMs   = 500,   // in milliseconds
+    eMaxPcrGapMs      = 1000,  // in milliseconds
+    eJitterSmoothing  = 64,
+    eMaxSamples       = 64
+  };
+  // Compact state of each pid, 6 bytes per pid
+  struct pidState {
+    uint8_t continuity;
+    uint8_t table;         // index into tablesM plus one, zero for others
+    uint8_t service;       // index into servicesM, zero for none
+    uint16_t ccErrors;     // saturating
+  };
+  struct tableState {
+    uint16_t pid;
+    uint64_t deadline;     // zero until the table is present in the stream
+  };
+  // Service referred by a PMT; the sample rings are guarded by mutexM
+  struct serviceState {
+    int program;
+    int pcrPid;
+    int version;           // -1 until the PMT is seen
+    bool hasPcr;
+    uint64_t lastPcr;      // in 27 MHz units
+    int64_t pcrClockNs;    // local time predicted by the PCRs
+    int64_t offsetNs;      // smoothed offset of the arrival time
+    unsigned int packets;  // since the last PCR
+    unsigned long muxPackets;
+    unsigned int count;
+    int intervalUs[eMaxSamples];
+    int jitterUs[eMaxSamples];
+    int bitrate[eMaxSamples];      // in kbit/s
+    int muxBitrate[eMaxSamples];   // in kbit/s
+  };
+  pidState pidsM[MAXPID];
+  uint32_t requestedM[MAXPID / 32];
+  tableState tablesM[eMaxTables];
+  serviceState servicesM[eMaxTables];
+  int tableCountM;
+  int patVersionM;
+  cMutex mutexM;
+  bool pcrM;
+  bool syncM;
+  int syncGoodM;
+  int syncBadM;
+  bool resetM;
+  // Running counters, written only by the receiving thread
+  unsigned long packetsM;
+  unsigned long syncLossM;
+  unsigned long syncByteErrorsM;
+  unsigned long ccErrorsM;
+  unsigned long patErrorsM;
+  unsigned long pmtErrorsM;
+  unsigned long transportErrorsM;
+  void Clear(void);
+  void Increment(unsigned long &counterP) { __atomic_store_n(&counterP, counterP + 1, __ATOMIC_RELAXED); }
+  void CheckTimeouts(uint64_t nowP);
+  void ClearServices(void);
+  void ParsePat(const uint8_t *sectionP, int lengthP);
+  void ParsePmt(const uint8_t *sectionP, int lengthP, int indexP);
+  void ProcessPcr(int indexP, uint64_t pcrP, bool discontinuityP, int64_t nowNsP);
+  void AnalyzePacket(const uint8_t *dataP, uint64_t nowMsP, int64_t arrivalNsP);
+  static int SortSamples(const void *data1P, const void *data2P);
+  static cString GetPercentiles(const char *nameP, const int *samplesP, int countP, int divisorP, const char *unitP);
+
+public:
+  cSatipTsMonitor();
+  virtual ~cSatipTsMonitor();
+  void Reset(void);
+  void SetPid(int pidP, bool onP);
+  void Analyze(const uint8_t *dataP, int lengthP, uint64_t arrivalP = 0);
+  cString GetInformation(void);
+  cString GetPcrInformation(void);
+};
+
+#endif // __SATIP_TSMONITOR_H
@@ -13,6 +13,9 @@
 #include "discover.h"
 #include "log.h"
 #include "poller.h"
+#include "capture.h"
+#include "share.h"
+#include "zap.h"
 #include "tuner.h"
 
 cSatipTuner::cSatipTuner(cSatipDeviceIf &deviceP, unsigned int packetLenP)
@@ -51,7 +54,15 @@ cSatipTuner::cSatipTuner(cSatipDeviceIf &deviceP, unsigned int packetLenP)
   pmtPidM(-1),
   addPidsM(),
   delPidsM(),
-  pidsM()
+  pidsM(),
+  sharedPidsM(),
+  shareKeyM(""),
+  shareRoleM(cSatipShares::eShareNone),
+  ownRtpPortM(-1),
+  ownRtcpPortM(-1),
+  multicastAddrM(""),
+  multicastSrcM(""),
+  adoptedSessionM("")
 {
   debug1("%s (, %d) [device %d]", __PRETTY_FUNCTION__, packetLenP, deviceIdM);
 
@@ -70,9 +81,12 @@ cSatipTuner::cSatipTuner(cSatipDeviceIf &deviceP, unsigned int packetLenP)
   if ((rtpM.Port() <= 0) || (rtcpM.Port() <= 0)) {
      error("Cannot open required RTP/RTCP ports [device %d]", deviceIdM);
      }
+  // Needed for getting back from a shared stream
+  ownRtpPortM = rtpM.Port();
+  ownRtcpPortM = rtcpM.Port();
   // Must be done after socket initialization!
-  cSatipPoller::GetInstance()->Register(rtpM);
-  cSatipPoller::GetInstance()->Register(rtcpM);
+  cSatipPoller::GetInstance()->Register(rtpM, deviceIdM);
+  cSatipPoller::GetInstance()->Register(rtcpM, deviceIdM);
 
   // Start thread
   Start();
@@ -84,14 +98,18 @@ cSatipTuner::~cSatipTuner()
 
   // Stop thread
   sleepM.Signal();
+  rtspM.Abort();
   if (Running())
      Cancel(3);
   Close();
+  LeaveShare();
   currentStateM = tsIdle;
   internalStateM.Clear();
   externalStateM.Clear();
 
   // Close the listening sockets
+  cSatipCapture::GetInstance()->Unregister(rtcpM);
+  cSatipCapture::GetInstance()->Unregister(rtpM);
   cSatipPoller::GetInstance()->Unregister(rtcpM);
   cSatipPoller::GetInstance()->Unregister(rtpM);
   rtcpM.Close();
@@ -108,10 +126,14 @@ void cSatipTuner::Action(void)
   reConnectM.Set(eConnectTimeoutMs);
   // Do the thread loop
   while (Running()) {
+        // Wake up on the nearest deadline, unless an event arrives sooner
+        int timeout = eSleepTimeoutMs;
         UpdateCurrentState();
         switch (currentStateM) {
           case tsIdle:
                debug4("%s: tsIdle [device %d]", __PRETTY_FUNCTION__, deviceIdM);
+               // Nothing to do before the next request
+               timeout = eIdleCheckTimeoutMs;
                break;
           case tsRelease:
                debug4("%s: tsRelease [device %d]", __PRETTY_FUNCTION__, deviceIdM);
@@ -128,7 +150,7 @@ void cSatipTuner::Action(void)
                   UpdatePids(true);
                   }
                else
-                  Disconnect();
+                  Disconnect(); // and retry after eSleepTimeoutMs
                break;
           case tsTuned:
                debug4("%s: tsTuned [device %d]", __PRETTY_FUNCTION__, deviceIdM);
@@ -152,6 +174,8 @@ void cSatipTuner::Action(void)
                   error("Tuning timeout - retuning [device %d]", deviceIdM);
                   RequestState(tsSet, smInternal);
                   }
+               // A lock report via RTCP will wake up earlier
+               timeout = min(RemainingMs(statusUpdateM), RemainingMs(tuning));
                break;
           case tsLocked:
                debug4("%s: tsLocked [device %d]", __PRETTY_FUNCTION__, deviceIdM);
@@ -181,13 +205,22 @@ void cSatipTuner::Action(void)
                   break;
                   }
                Receive();
+               timeout = min(min(RemainingMs(keepAliveM), RemainingMs(reConnectM)), RemainingMs(idleCheck));
+               // Give up the missing RTP packets also when the stream has stalled
+               if (rtpM.ReleaseExpired())
+                  timeout = min(timeout, max((int)SatipConfig.GetRtpReorderTimeout(), 1));
+               if (PidsPending())
+                  timeout = min(timeout, RemainingMs(pidUpdateCacheM));
+               // The interleaved data is read only by polling without the interleave reader
+               if (rtspM.IsReceivePolled())
+                  timeout = min(timeout, (int)eSleepTimeoutMs);
                break;
           default:
                error("Unknown tuner status %d [device %d]", currentStateM, deviceIdM);
                break;
           }
         if (!StateRequested())
-           sleepM.Wait(eSleepTimeoutMs); // to avoid busy loop and reduce cpu load
+           sleepM.Wait(max(timeout, 1)); // to avoid busy loop and reduce cpu load
         }
   debug1("%s Exiting [device %d]", __PRETTY_FUNCTION__, deviceIdM);
 }
@@ -215,67 +248,133 @@ bool cSatipTuner::Close(void)
 
 bool cSatipTuner::Connect(void)
 {
-  cMutexLock MutexLock(&mutexM);
   debug1("%s [device %d]", __PRETTY_FUNCTION__, deviceIdM);
-
-  if (!isempty(*streamAddrM)) {
-     cString connectionUri = GetBaseUrl(*streamAddrM, streamPortM);
-     tnrParamM = "";
-     // Just retune
-     if (streamIdM >= 0) {
-        if (!strcmp(*streamParamM, *lastParamM) && hasLockM) {
-           debug1("%s Identical parameters [device %d]", __PRETTY_FUNCTION__, deviceIdM);
-           //return true; // fall through because detection does not work reliably
-           }
-        cString uri = cString::sprintf("%sstream=%d?%s", *connectionUri, streamIdM, *streamParamM);
-        debug1("%s Retuning [device %d]", __PRETTY_FUNCTION__, deviceIdM);
-        if (rtspM.Play(*uri)) {
-           keepAliveM.Set(timeoutM);
+  cSatipTunerServer server(NULL, deviceIdM, 0);
+  cString connectionUri, streamParam, pids;
+  int streamId;
+
+  // Any abort of the previous connection has been served already
+  rtspM.ResetAbort();
+  // Attach to the multicast stream of another device, if it's already flowing
+  switch (JoinShare()) {
+    case cSatipShares::eShareFollower:
+         {
+           cMutexLock MutexLock(&mutexM);
            lastParamM = streamParamM;
-           return true;
-           }
-        }
-     else if (rtspM.SetInterface(nextServerM.IsValid() ? *nextServerM.GetSrcAddress() : NULL) && rtspM.Options(*connectionUri)) {
-        cString uri = cString::sprintf("%s?%s", *connectionUri, *streamParamM);
-        bool useTcp = SatipConfig.IsTransportModeRtpOverTcp() && nextServerM.IsValid() && nextServerM.IsQuirk(cSatipServer::eSatipQuirkRtpOverTcp);
-        // Flush any old content
-        //rtpM.Flush();
-        //rtcpM.Flush();
-        if (useTcp)
-           debug1("%s Requesting TCP [device %d]", __PRETTY_FUNCTION__, deviceIdM);
-        if (rtspM.Setup(*uri, rtpM.Port(), rtcpM.Port(), useTcp)) {
-           lastParamM = streamParamM;
-           keepAliveM.Set(timeoutM);
+           lastAddrM = GetBaseUrl(*streamAddrM, streamPortM);
            if (nextServerM.IsValid()) {
               currentServerM = nextServerM;
               nextServerM.Reset();
               }
-           lastAddrM = connectionUri;
-           currentServerM.Attach();
-           return true;
-           }
+         }
+         return true;
+    case cSatipShares::eSharePending:
+         debug1("%s Waiting for the shared stream [device %d]", __PRETTY_FUNCTION__, deviceIdM);
+         return false;
+    default:
+         break;
+    }
+
+  // Take a snapshot, as the requests are sent without holding the mutex
+  {
+    cMutexLock MutexLock(&mutexM);
+    if (isempty(*streamAddrM))
+       return false;
+    connectionUri = GetBaseUrl(*streamAddrM, streamPortM);
+    streamParam = streamParamM;
+    streamId = streamIdM;
+    server = nextServerM;
+    if (SatipConfig.GetFastTune() && pidsM.Size())
+       pids = pidsM.ListPids();
+    tnrParamM = "";
+    // Just retune
+    if ((streamId >= 0) && !strcmp(*streamParamM, *lastParamM) && hasLockM) {
+       debug1("%s Identical parameters [device %d]", __PRETTY_FUNCTION__, deviceIdM);
+       //return true; // fall through because detection does not work reliably
+       }
+  }
+
+  if (streamId >= 0) {
+     cString uri = cString::sprintf("%sstream=%d?%s", *connectionUri, streamId, *streamParam);
+     debug1("%s Retuning [device %d]", __PRETTY_FUNCTION__, deviceIdM);
+     if (rtspM.Play(*uri)) {
+        {
+          cMutexLock MutexLock(&mutexM);
+          cSatipZapProfiler::GetInstance()->Mark(deviceIdM, SATIP_ZAP_PHASE_PLAY);
+          keepAliveM.Set(timeoutM);
+          lastParamM = streamParam;
+        }
+        PublishShare();
+        return true;
+        }
+     }
+  else if (rtspM.SetInterface(server.IsValid() ? *server.GetSrcAddress() : NULL) &&
+           ((SatipConfig.GetFastTune() && server.IsAttached()) || rtspM.Options(*connectionUri))) {
+     // In fast tuning mode, the OPTIONS round trip is skipped as another session keeps the server alive
+     cSatipZapProfiler::GetInstance()->Mark(deviceIdM, SATIP_ZAP_PHASE_OPTIONS);
+     cString uri = cString::sprintf("%s?%s", *connectionUri, *streamParam);
+     bool useTcp = SatipConfig.IsTransportModeRtpOverTcp() && server.IsValid() && server.IsQuirk(cSatipServer::eSatipQuirkRtpOverTcp);
+     // Fold the current pids already into the SETUP request to get the stream flowing sooner
+     if (!isempty(*pids))
+        uri = cString::sprintf("%s&pids=%s", *uri, *pids);
+     // Flush any old content
+     //rtpM.Flush();
+     //rtcpM.Flush();
+     if (useTcp)
+        debug1("%s Requesting TCP [device %d]", __PRETTY_FUNCTION__, deviceIdM);
+     if (rtspM.Setup(*uri, rtpM.Port(), rtcpM.Port(), useTcp)) {
+        {
+          cMutexLock MutexLock(&mutexM);
+          cSatipZapProfiler::GetInstance()->Mark(deviceIdM, SATIP_ZAP_PHASE_SETUP);
+          lastParamM = streamParam;
+          keepAliveM.Set(timeoutM);
+          if (server.IsValid()) {
+             currentServerM = server;
+             // Keep any server given meanwhile via SetSource()
+             if (!strcmp(*streamParamM, *streamParam))
+                nextServerM.Reset();
+             }
+          lastAddrM = connectionUri;
+          currentServerM.Attach();
+        }
+        PublishShare();
+        return true;
         }
-     rtspM.Reset();
-     streamIdM = -1;
-     error("Connect failed [device %d]", deviceIdM);
      }
+  rtspM.Reset();
+  {
+    cMutexLock MutexLock(&mutexM);
+    streamIdM = -1;
+  }
+  // Let the waiting devices try on their own
+  LeaveShare();
+  error("Connect failed [device %d]", deviceIdM);
 
   return false;
 }
 
 bool cSatipTuner::Disconnect(void)
 {
-  cMutexLock MutexLock(&mutexM);
   debug1("%s [device %d]", __PRETTY_FUNCTION__, deviceIdM);
-
-  if (!isempty(*lastAddrM) && (streamIdM >= 0)) {
-     cString uri = cString::sprintf("%sstream=%d", *lastAddrM, streamIdM);
+  cString uri;
+
+  // A shared session is either handed over or left to the other devices
+  LeaveShare();
+  {
+    cMutexLock MutexLock(&mutexM);
+    if (!isempty(*lastAddrM) && (streamIdM >= 0))
+       uri = cString::sprintf("%sstream=%d", *lastAddrM, streamIdM);
+  }
+  if (!isempty(*uri)) {
      rtspM.Teardown(*uri);
      // some devices requires a teardown for TCP connection also
      rtspM.Reset();
-     streamIdM = -1;
      }
 
+  cMutexLock MutexLock(&mutexM);
+  if (!isempty(*uri))
+     streamIdM = -1;
+
   // Reset signal parameters
   hasLockM = false;
   signalStrengthDBmM = 0.0;
@@ -294,18 +393,25 @@ bool cSatipTuner::Disconnect(void)
   return true;
 }
 
-void cSatipTuner::ProcessVideoData(u_char *bufferP, int lengthP)
+void cSatipTuner::ProcessVideoData(u_char *bufferP, int lengthP, uint64_t arrivalP)
 {
   debug16("%s (, %d) [device %d]", __PRETTY_FUNCTION__, lengthP, deviceIdM);
   if (lengthP > 0) {
      uint64_t elapsed;
      cTimeMs processing(0);
 
+     cSatipZapProfiler::GetInstance()->Mark(deviceIdM, SATIP_ZAP_PHASE_RTP);
      AddTunerStatistic(lengthP);
      elapsed = processing.Elapsed();
      if (elapsed > 1)
         debug6("%s AddTunerStatistic() took %" PRIu64 " ms [device %d]", __PRETTY_FUNCTION__, elapsed, deviceIdM);
 
+     processing.Set(0);
+     monitorM.Analyze(bufferP, lengthP, arrivalP);
+     elapsed = processing.Elapsed();
+     if (elapsed > 1)
+        debug6("%s Analyze() took %" PRIu64 " ms [device %d]", __PRETTY_FUNCTION__, elapsed, deviceIdM);
+
      processing.Set(0);
      deviceM->WriteData(bufferP, lengthP);
      elapsed = processing.Elapsed();
@@ -315,6 +421,38 @@ void cSatipTuner::ProcessVideoData(u_char *bufferP, int lengthP)
   reConnectM.Set(eConnectTimeoutMs);
 }
 
+u_char *cSatipTuner::GetVideoBuffer(int &lengthP)
+{
+  debug16("%s [device %d]", __PRETTY_FUNCTION__, deviceIdM);
+  return deviceM->GetWriteBuffer(lengthP);
+}
+
+void cSatipTuner::AnalyzeVideoData(u_char *bufferP, int lengthP, uint64_t arrivalP)
+{
+  debug16("%s (, %d) [device %d]", __PRETTY_FUNCTION__, lengthP, deviceIdM);
+  // The payload of each datagram is analyzed in place before the whole batch is committed
+  if (lengthP > 0)
+     monitorM.Analyze(bufferP, lengthP, arrivalP);
+}
+
+void cSatipTuner::CommitVideoData(u_char *bufferP, int lengthP)
+{
+  debug16("%s (, %d) [device %d]", __PRETTY_FUNCTION__, lengthP, deviceIdM);
+  if (lengthP > 0) {
+     uint64_t elapsed;
+     cTimeMs processing(0);
+
+     cSatipZapProfiler::GetInstance()->Mark(deviceIdM, SATIP_ZAP_PHASE_RTP);
+     AddTunerStatistic(lengthP);
+     processing.Set(0);
+     deviceM->CommitData(bufferP, lengthP);
+     elapsed = processing.Elapsed();
+     if (elapsed > 1)
+        debug6("%s CommitData() took %" PRIu64 " ms [device %d]", __FUNCTION__, elapsed, deviceIdM);
+     }
+  reConnectM.Set(eConnectTimeoutMs);
+}
+
 void cSatipTuner::ProcessRtpData(u_char *bufferP, int lengthP)
 {
   rtpM.Process(bufferP, lengthP);
@@ -357,7 +495,14 @@ void cSatipTuner::ProcessApplicationData(u_char *bufferP, int lengthP)
         // "0" the frontend is not locked
         // "1" the frontend is locked
         c = strstr(c, ",");
-        hasLockM = !!atoi(++c);
+        bool lock = !!atoi(++c);
+        // A lock left over from the previous transponder doesn't count for the zap
+        if (lock)
+           cSatipZapProfiler::GetInstance()->Mark(deviceIdM, SATIP_ZAP_PHASE_LOCK);
+        // Proceed immediately after the first lock report
+        if (lock && !hasLockM)
+           sleepM.Signal();
+        hasLockM = lock;
 
         // quality:
         // Numerical value between 0 and 15
@@ -402,8 +547,11 @@ void cSatipTuner::SetupTransport(int rtpPortP, int rtcpPortP, const char *stream
   cMutexLock MutexLock(&mutexM);
   debug1("%s (%d, %d, %s, %s) [device %d]", __PRETTY_FUNCTION__, rtpPortP, rtcpPortP, streamAddrP, sourceAddrP, deviceIdM);
   bool multicast = !isempty(streamAddrP);
+  multicastAddrM = multicast ? streamAddrP : "";
+  multicastSrcM = (multicast && sourceAddrP) ? sourceAddrP : "";
   // Adapt RTP to any transport media change
   if (multicast != rtpM.IsMulticast() || rtpPortP != rtpM.Port()) {
+     cSatipCapture::GetInstance()->Unregister(rtpM);
      cSatipPoller::GetInstance()->Unregister(rtpM);
      if (rtpPortP >= 0) {
         rtpM.Close();
@@ -411,11 +559,15 @@ void cSatipTuner::SetupTransport(int rtpPortP, int rtcpPortP, const char *stream
            rtpM.OpenMulticast(rtpPortP, streamAddrP, sourceAddrP);
         else
            rtpM.Open(rtpPortP);
-        cSatipPoller::GetInstance()->Register(rtpM);
+        cSatipPoller::GetInstance()->Register(rtpM, deviceIdM);
+        // The capture engine takes over the data, the socket only keeps the membership
+        if (multicast && cSatipCapture::GetInstance()->Register(rtpM, streamAddrP, sourceAddrP, rtpPortP))
+           rtpM.Discard();
         }
      }
   // Adapt RTCP to any transport media change
   if (multicast != rtcpM.IsMulticast() || rtcpPortP != rtcpM.Port()) {
+     cSatipCapture::GetInstance()->Unregister(rtcpM);
      cSatipPoller::GetInstance()->Unregister(rtcpM);
      if (rtcpPortP >= 0) {
         rtcpM.Close();
@@ -423,7 +575,9 @@ void cSatipTuner::SetupTransport(int rtpPortP, int rtcpPortP, const char *stream
            rtcpM.OpenMulticast(rtcpPortP, streamAddrP, sourceAddrP);
         else
            rtcpM.Open(rtcpPortP);
-        cSatipPoller::GetInstance()->Register(rtcpM);
+        cSatipPoller::GetInstance()->Register(rtcpM, deviceIdM);
+        if (multicast && cSatipCapture::GetInstance()->Register(rtcpM, streamAddrP, sourceAddrP, rtcpPortP))
+           rtcpM.Discard();
         }
      }
 }
@@ -444,6 +598,125 @@ int cSatipTuner::GetId(void)
   return deviceIdM;
 }
 
+void cSatipTuner::UpdateSharedPids(void)
+{
+  debug16("%s [device %d]", __PRETTY_FUNCTION__, deviceIdM);
+  // The pids are collected on the next update
+  sleepM.Signal();
+}
+
+void cSatipTuner::AdoptSession(const char *sessionP, int streamIdP, int timeoutP)
+{
+  cMutexLock MutexLock(&mutexM);
+  debug1("%s (%s, %d, %d) [device %d]", __PRETTY_FUNCTION__, sessionP, streamIdP, timeoutP, deviceIdM);
+  shareRoleM = cSatipShares::eShareOwner;
+  sessionM = sessionP;
+  // The session id is given into the RTSP handle by the tuner thread
+  adoptedSessionM = sessionP;
+  streamIdM = streamIdP;
+  timeoutM = timeoutP;
+  lastAddrM = GetBaseUrl(*streamAddrM, streamPortM);
+  keepAliveM.Set(0);
+  currentServerM.Attach();
+  sleepM.Signal();
+}
+
+int cSatipTuner::JoinShare(void)
+{
+  debug1("%s [device %d]", __PRETTY_FUNCTION__, deviceIdM);
+  cString key, lastKey, streamAddr, sourceAddr;
+  cSatipServer *server;
+  int transponder;
+  int rtpPort = -1, rtcpPort = -1;
+
+  {
+    cMutexLock MutexLock(&mutexM);
+    if (!SatipConfig.IsTransportModeMulticast() || isempty(*streamAddrM))
+       return cSatipShares::eShareNone;
+    key = cString::sprintf("%s?%s", *GetBaseUrl(*streamAddrM, streamPortM), *streamParamM);
+    // The frontend assignment looks up the shares by the server and transponder
+    server = nextServerM.IsValid() ? nextServerM.Server() : currentServerM.Server();
+    transponder = nextServerM.IsValid() ? nextServerM.Transponder() : currentServerM.Transponder();
+    lastKey = shareKeyM;
+    if (!isempty(*lastKey) && !strcmp(*key, *lastKey))
+       return shareRoleM;
+  }
+  // The transponder has been changed
+  if (!isempty(*lastKey))
+     LeaveShare();
+  int role = cSatipShares::GetInstance()->Join(*key, server, transponder, *this, streamAddr, sourceAddr, rtpPort, rtcpPort);
+  {
+    cMutexLock MutexLock(&mutexM);
+    shareKeyM = (role == cSatipShares::eSharePending) ? "" : *key;
+    shareRoleM = (role == cSatipShares::eSharePending) ? cSatipShares::eShareNone : role;
+    if (role == cSatipShares::eShareFollower)
+       streamIdM = -1;
+  }
+  if (role == cSatipShares::eShareFollower)
+     SetupTransport(rtpPort, rtcpPort, *streamAddr, *sourceAddr);
+
+  return role;
+}
+
+void cSatipTuner::PublishShare(void)
+{
+  debug1("%s [device %d]", __PRETTY_FUNCTION__, deviceIdM);
+  cString key, streamAddr, sourceAddr, session;
+  int rtpPort, rtcpPort, streamId, timeout;
+
+  {
+    cMutexLock MutexLock(&mutexM);
+    if (isempty(*shareKeyM) || (shareRoleM != cSatipShares::eShareOwner))
+       return;
+    key = shareKeyM;
+    streamAddr = multicastAddrM;
+    sourceAddr = multicastSrcM;
+    rtpPort = rtpM.Port();
+    rtcpPort = rtcpM.Port();
+    session = sessionM;
+    streamId = streamIdM;
+    timeout = timeoutM;
+  }
+  // Nothing to share without a multicast group from the server
+  if (isempty(*streamAddr) || (streamId < 0))
+     LeaveShare();
+  else
+     cSatipShares::GetInstance()->Publish(*key, *this, *streamAddr, *sourceAddr, rtpPort, rtcpPort, *session, streamId, timeout);
+}
+
+bool cSatipTuner::LeaveShare(void)
+{
+  cString key;
+  int role;
+
+  {
+    cMutexLock MutexLock(&mutexM);
+    key = shareKeyM;
+    role = shareRoleM;
+    shareKeyM = "";
+    shareRoleM = cSatipShares::eShareNone;
+    sharedPidsM.Clear();
+  }
+  if (isempty(*key))
+     return false;
+  debug1("%s (%s) [device %d]", __PRETTY_FUNCTION__, *key, deviceIdM);
+  bool handedOver = cSatipShares::GetInstance()->Leave(*key, *this);
+  if (handedOver || (role == cSatipShares::eShareFollower)) {
+     // The session belongs now to the other devices
+     {
+       cMutexLock MutexLock(&mutexM);
+       streamIdM = -1;
+       sessionM = "";
+       adoptedSessionM = "";
+       hasLockM = false;
+     }
+     rtspM.Reset();
+     SetupTransport(ownRtpPortM, ownRtcpPortM, NULL, NULL);
+     }
+
+  return handedOver;
+}
+
 bool cSatipTuner::SetSource(cSatipServer *serverP, const int transponderP, const char *parameterP, const int indexP)
 {
   debug1("%s (%d, %s, %d) [device %d]", __PRETTY_FUNCTION__, transponderP, parameterP, indexP, deviceIdM);
@@ -458,11 +731,16 @@ bool cSatipTuner::SetSource(cSatipServer *serverP, const int transponderP, const
         // Modify parameter if required
         if (nextServerM.IsQuirk(cSatipServer::eSatipQuirkForcePilot) && strstr(parameterP, "msys=dvbs2") && !strstr(parameterP, "plts="))
            streamParamM = rtspM.RtspUnescapeString(*cString::sprintf("%s&plts=on", parameterP));
+        // Start monitoring the new stream from scratch
+        monitorM.Reset();
         // Reconnect
         if (!isempty(*lastAddrM)) {
            cString connectionUri = GetBaseUrl(*streamAddrM, streamPortM);
-           if (strcmp(*connectionUri, *lastAddrM))
+           if (strcmp(*connectionUri, *lastAddrM)) {
+              // Don't let a pending request to the previous server delay the switch
+              rtspM.Abort();
               RequestState(tsRelease, smInternal);
+              }
            }
         RequestState(tsSet, smExternal);
         setupTimeoutM.Set(eSetupTimeoutMs);
@@ -480,6 +758,7 @@ bool cSatipTuner::SetPid(int pidP, int typeP, bool onP)
 {
   debug16("%s (%d, %d, %d) [device %d]", __PRETTY_FUNCTION__, pidP, typeP, onP, deviceIdM);
   cMutexLock MutexLock(&mutexM);
+  monitorM.SetPid(pidP, onP);
   if (onP) {
      pidsM.AddPid(pidP);
      addPidsM.AddPid(pidP);
@@ -499,67 +778,122 @@ bool cSatipTuner::SetPid(int pidP, int typeP, bool onP)
 bool cSatipTuner::UpdatePids(bool forceP)
 {
   debug16("%s (%d) tunerState=%s [device %d]", __PRETTY_FUNCTION__, forceP, TunerStateString(currentStateM), deviceIdM);
-  cMutexLock MutexLock(&mutexM);
-  if (((forceP && pidsM.Size()) || (pidUpdateCacheM.TimedOut() && (addPidsM.Size() || delPidsM.Size()))) &&
-      !isempty(*streamAddrM) && (streamIdM > 0)) {
-     cString uri = cString::sprintf("%sstream=%d", *GetBaseUrl(*streamAddrM, streamPortM), streamIdM);
-     bool useci = (SatipConfig.GetCIExtension() && currentServerM.HasCI());
-     bool usedummy = currentServerM.IsQuirk(cSatipServer::eSatipQuirkPlayPids);
-     bool paramadded = false;
-     if (forceP || usedummy) {
-        if (pidsM.Size()) {
-           uri = cString::sprintf("%s%spids=%s", *uri, paramadded ? "&" : "?", *pidsM.ListPids());
-           if (usedummy && (pidsM.Size() == 1) && (pidsM[0] < 0x20))
-              uri = cString::sprintf("%s,%d", *uri, eDummyPid);
-           paramadded = true;
-           }
-        }
-     else {
-        if (addPidsM.Size()) {
-           uri = cString::sprintf("%s%saddpids=%s", *uri, paramadded ? "&" : "?", *addPidsM.ListPids());
-           paramadded = true;
-           }
-        if (delPidsM.Size()) {
-           uri = cString::sprintf("%s%sdelpids=%s", *uri, paramadded ? "&" : "?", *delPidsM.ListPids());
-           paramadded = true;
-           }
-        }
-     if (useci) {
-        if (currentServerM.IsQuirk(cSatipServer::eSatipQuirkCiXpmt)) {
-           // CI extension parameters:
-           // - x_pmt : specifies the PMT of the service you want the CI to decode
-           // - x_ci  : specfies which CI slot (1..n) to use
-           //           value 0 releases the CI slot
-           //           CI slot released automatically if the stream is released,
-           //           but not when used retuning to another channel
-           int pid = deviceM->GetPmtPid();
-           if ((pid > 0) && (pid != pmtPidM)) {
-              int slot = deviceM->GetCISlot();
-              uri = cString::sprintf("%s%sx_pmt=%d", *uri, paramadded ? "&" : "?", pid);
-              if (slot > 0)
-                 uri = cString::sprintf("%s&x_ci=%d", *uri, slot);
-              paramadded = true;
-              }
-           pmtPidM = pid;
+  cString uri, key, session, sharedPids;
+
+  {
+    cMutexLock MutexLock(&mutexM);
+    key = shareKeyM;
+    sharedPids = pidsM.ListPids();
+    session = adoptedSessionM;
+    adoptedSessionM = "";
+  }
+  // Continue the session of the previous owner with the full pid list
+  if (!isempty(*session)) {
+     rtspM.SetSession(*session);
+     forceP = true;
+     }
+  // Keep the other devices of a shared stream informed about the own pids
+  if (!isempty(*key)) {
+     cSatipShares::GetInstance()->SetPids(*key, *this, *sharedPids);
+     sharedPids = cSatipShares::GetInstance()->GetPids(*key);
+     }
+  else
+     sharedPids = "";
+
+  {
+    cMutexLock MutexLock(&mutexM);
+    // The owner of a shared stream takes care of the pids
+    if (shareRoleM == cSatipShares::eShareFollower) {
+       addPidsM.Clear();
+       delPidsM.Clear();
+       return true;
+       }
+    cSatipPid unionPids;
+    bool shared = !isempty(*sharedPids);
+    cSatipPid &pids = shared ? unionPids : pidsM;
+    if (shared || sharedPidsM.Size()) {
+       // Request just the changes in the union of the pids of all devices
+       unionPids.ParsePids(shared ? *sharedPids : *pidsM.ListPids());
+       addPidsM.Clear();
+       delPidsM.Clear();
+       for (int i = 0; i < unionPids.Size(); ++i) {
+           if (sharedPidsM.IndexOf(unionPids[i]) < 0)
+              addPidsM.AddPid(unionPids[i]);
            }
-        else if (currentServerM.IsQuirk(cSatipServer::eSatipQuirkCiTnr)) {
-           // CI extension parameters:
-           // - tnr : specifies a channel config entry
-           cString param = deviceM->GetTnrParameterString();
-           if (!isempty(*param) && strcmp(*tnrParamM, *param) != 0) {
-              uri = cString::sprintf("%s%stnr=%s", *uri, paramadded ? "&" : "?", *param);
-              paramadded = true;
-              }
-           tnrParamM = param;
+       for (int i = 0; i < sharedPidsM.Size(); ++i) {
+           if (unionPids.IndexOf(sharedPidsM[i]) < 0)
+              delPidsM.AddPid(sharedPidsM[i]);
            }
-        }
-     if (paramadded) {
-        pidUpdateCacheM.Set(ePidUpdateIntervalMs);
-        if (!rtspM.Play(*uri))
-           return false;
-        }
-     addPidsM.Clear();
-     delPidsM.Clear();
+       }
+    if (((forceP && pids.Size()) || (pidUpdateCacheM.TimedOut() && (addPidsM.Size() || delPidsM.Size()))) &&
+        !isempty(*streamAddrM) && (streamIdM > 0)) {
+       uri = cString::sprintf("%sstream=%d", *GetBaseUrl(*streamAddrM, streamPortM), streamIdM);
+       bool useci = (SatipConfig.GetCIExtension() && currentServerM.HasCI());
+       bool usedummy = currentServerM.IsQuirk(cSatipServer::eSatipQuirkPlayPids);
+       bool paramadded = false;
+       if (forceP || usedummy) {
+          if (pids.Size()) {
+             uri = cString::sprintf("%s%spids=%s", *uri, paramadded ? "&" : "?", *pids.ListPids());
+             if (usedummy && (pids.Size() == 1) && (pids[0] < 0x20))
+                uri = cString::sprintf("%s,%d", *uri, eDummyPid);
+             paramadded = true;
+             }
+          }
+       else {
+          if (addPidsM.Size()) {
+             uri = cString::sprintf("%s%saddpids=%s", *uri, paramadded ? "&" : "?", *addPidsM.ListPids());
+             paramadded = true;
+             }
+          if (delPidsM.Size()) {
+             uri = cString::sprintf("%s%sdelpids=%s", *uri, paramadded ? "&" : "?", *delPidsM.ListPids());
+             paramadded = true;
+             }
+          }
+       if (useci) {
+          if (currentServerM.IsQuirk(cSatipServer::eSatipQuirkCiXpmt)) {
+             // CI extension parameters:
+             // - x_pmt : specifies the PMT of the service you want the CI to decode
+             // - x_ci  : specfies which CI slot (1..n) to use
+             //           value 0 releases the CI slot
+             //           CI slot released automatically if the stream is released,
+             //           but not when used retuning to another channel
+             int pid = deviceM->GetPmtPid();
+             if ((pid > 0) && (pid != pmtPidM)) {
+                int slot = deviceM->GetCISlot();
+                uri = cString::sprintf("%s%sx_pmt=%d", *uri, paramadded ? "&" : "?", pid);
+                if (slot > 0)
+                   uri = cString::sprintf("%s&x_ci=%d", *uri, slot);
+                paramadded = true;
+                }
+             pmtPidM = pid;
+             }
+          else if (currentServerM.IsQuirk(cSatipServer::eSatipQuirkCiTnr)) {
+             // CI extension parameters:
+             // - tnr : specifies a channel config entry
+             cString param = deviceM->GetTnrParameterString();
+             if (!isempty(*param) && strcmp(*tnrParamM, *param) != 0) {
+                uri = cString::sprintf("%s%stnr=%s", *uri, paramadded ? "&" : "?", *param);
+                paramadded = true;
+                }
+             tnrParamM = param;
+             }
+          }
+       if (paramadded)
+          pidUpdateCacheM.Set(ePidUpdateIntervalMs);
+       else
+          uri = "";
+       // Any pids changed during the request will be collected for the next update
+       addPidsM.Clear();
+       delPidsM.Clear();
+       sharedPidsM.ParsePids(shared ? *sharedPids : "");
+       }
+  }
+
+  if (!isempty(*uri)) {
+     // A failed update causes a retune with the full pid list
+     if (!rtspM.Play(*uri))
+        return false;
+     cSatipZapProfiler::GetInstance()->Mark(deviceIdM, SATIP_ZAP_PHASE_PLAY);
      }
 
   return true;
@@ -568,12 +902,14 @@ bool cSatipTuner::UpdatePids(bool forceP)
 bool cSatipTuner::Receive(void)
 {
   debug16("%s tunerState=%s [device %d]", __PRETTY_FUNCTION__, TunerStateString(currentStateM), deviceIdM);
-  cMutexLock MutexLock(&mutexM);
-  if (!isempty(*streamAddrM)) {
-     cString uri = GetBaseUrl(*streamAddrM, streamPortM);
-     if (!rtspM.Receive(*uri))
-        return false;
-     }
+  cString uri;
+  {
+    cMutexLock MutexLock(&mutexM);
+    if (!isempty(*streamAddrM))
+       uri = GetBaseUrl(*streamAddrM, streamPortM);
+  }
+  if (!isempty(*uri) && !rtspM.Receive(*uri))
+     return false;
 
   return true;
 }
@@ -581,16 +917,21 @@ bool cSatipTuner::Receive(void)
 bool cSatipTuner::KeepAlive(bool forceP)
 {
   debug16("%s (%d) tunerState=%s [device %d]", __PRETTY_FUNCTION__, forceP, TunerStateString(currentStateM), deviceIdM);
-  cMutexLock MutexLock(&mutexM);
-  if (keepAliveM.TimedOut()) {
-     keepAliveM.Set(timeoutM);
-     forceP = true;
-     }
-  if (forceP && !isempty(*streamAddrM)) {
-     cString uri = GetBaseUrl(*streamAddrM, streamPortM);
-     if (!rtspM.Options(*uri))
-        return false;
-     }
+  cString uri;
+  {
+    cMutexLock MutexLock(&mutexM);
+    if (keepAliveM.TimedOut()) {
+       keepAliveM.Set(timeoutM);
+       forceP = true;
+       }
+    // The session of a shared stream is kept alive by its owner
+    if (shareRoleM == cSatipShares::eShareFollower)
+       forceP = false;
+    if (forceP && !isempty(*streamAddrM))
+       uri = GetBaseUrl(*streamAddrM, streamPortM);
+  }
+  if (!isempty(*uri) && !rtspM.Options(*uri))
+     return false;
 
   return true;
 }
@@ -598,16 +939,18 @@ bool cSatipTuner::KeepAlive(bool forceP)
 bool cSatipTuner::ReadReceptionStatus(bool forceP)
 {
   debug16("%s (%d) tunerState=%s [device %d]", __PRETTY_FUNCTION__, forceP, TunerStateString(currentStateM), deviceIdM);
-  cMutexLock MutexLock(&mutexM);
-  if (statusUpdateM.TimedOut()) {
-     statusUpdateM.Set(eStatusUpdateTimeoutMs);
-     forceP = true;
-     }
-  if (forceP && !isempty(*streamAddrM) && (streamIdM > 0)) {
-     cString uri = cString::sprintf("%sstream=%d", *GetBaseUrl(*streamAddrM, streamPortM), streamIdM);
-     if (rtspM.Describe(*uri))
-        return true;
-     }
+  cString uri;
+  {
+    cMutexLock MutexLock(&mutexM);
+    if (statusUpdateM.TimedOut()) {
+       statusUpdateM.Set(eStatusUpdateTimeoutMs);
+       forceP = true;
+       }
+    if (forceP && !isempty(*streamAddrM) && (streamIdM > 0))
+       uri = cString::sprintf("%sstream=%d", *GetBaseUrl(*streamAddrM, streamPortM), streamIdM);
+  }
+  if (!isempty(*uri) && rtspM.Describe(*uri))
+     return true;
 
   return false;
 }
@@ -668,10 +1011,24 @@ bool cSatipTuner::RequestState(eTunerState stateP, eStateMode modeP)
      }
   else
      return false;
+  sleepM.Signal();
 
   return true;
 }
 
+bool cSatipTuner::PidsPending(void)
+{
+  cMutexLock MutexLock(&mutexM);
+  // Only the changes UpdatePids() is able to send count, the others would just spin the thread
+  return ((addPidsM.Size() || delPidsM.Size()) && !isempty(*streamAddrM) && (streamIdM > 0));
+}
+
+int cSatipTuner::RemainingMs(const cTimeMs &timerP)
+{
+  // The timers are set into the future, so the elapsed time is negative until the timeout
+  return timerP.TimedOut() ? 0 : (int)min((uint64_t)0 - timerP.Elapsed(), (uint64_t)eIdleCheckTimeoutMs);
+}
+
 const char *cSatipTuner::StateModeString(eStateMode modeP)
 {
   switch (modeP) {
@@ -742,6 +1099,41 @@ cString cSatipTuner::GetSignalStatus(void)
   return cString::sprintf("lock=%d strength=%d quality=%d frontend=%d", HasLock(), SignalStrength(), SignalQuality(), FrontendId());
 }
 
+cString cSatipTuner::GetRtpInformation(void)
+{
+  debug16("%s [device %d]", __PRETTY_FUNCTION__, deviceIdM);
+  return rtpM.GetInformation();
+}
+
+cString cSatipTuner::GetReceiveInformation(void)
+{
+  debug16("%s [device %d]", __PRETTY_FUNCTION__, deviceIdM);
+  cString info = cString::sprintf("RTP socket: %s rcvbuf=%d\nRTCP socket: %s rcvbuf=%d\n",
+                                 *rtpM.GetSocketStatistic(), rtpM.GetRcvBufSize(),
+                                 *rtcpM.GetSocketStatistic(), rtcpM.GetRcvBufSize());
+  if (shareRoleM != cSatipShares::eShareNone)
+     info = cString::sprintf("%sShared stream: %s\n", *info, (shareRoleM == cSatipShares::eShareOwner) ? "owner" : "follower");
+  if (cSatipCapture::GetInstance()->IsActive())
+     info = cString::sprintf("%sCapture: %s\n", *info, *cSatipCapture::GetInstance()->GetInformation());
+  return info;
+}
+
+void cSatipTuner::GetMetrics(satipMetrics &metricsP)
+{
+  debug16("%s [device %d]", __PRETTY_FUNCTION__, deviceIdM);
+  // Only plain reads, so the exporter never waits for the tuner thread
+  metricsP.tuned = IsTuned();
+  metricsP.locked = HasLock();
+  metricsP.strength = signalStrengthM;
+  metricsP.quality = signalQualityM;
+  metricsP.strengthDBm = signalStrengthDBmM;
+  metricsP.receivedBytes = GetTunerBytes();
+  rtpM.GetSequenceStatistics(metricsP.rtpLost, metricsP.rtpLate, metricsP.rtpDuplicate, metricsP.rtpReordered);
+  metricsP.socketDrops = rtpM.GetKernelDrops();
+  metricsP.jitterNs = rtpM.GetJitter();
+  rtspM.GetRequestStatistics(metricsP.rtspRequests, metricsP.rtspFailures, metricsP.rtspTimeMs);
+}
+
 cString cSatipTuner::GetInformation(void)
 {
   debug16("%s [device %d]", __PRETTY_FUNCTION__, deviceIdM);
@@ -13,11 +13,13 @@
 
 #include "deviceif.h"
 #include "discover.h"
+#include "metrics.h"
 #include "rtp.h"
 #include "rtcp.h"
 #include "rtsp.h"
 #include "server.h"
 #include "statistics.h"
+#include "tsmonitor.h"
 
 class cSatipPid : public cVector<int> {
 private:
@@ -37,6 +39,19 @@ public:
     if (AppendUnique(pidP))
        Sort(PidCompare);
   }
+  void ParsePids(const char *listP)
+  {
+    Clear();
+    while (!isempty(listP)) {
+          char *end;
+          int pid = strtol(listP, &end, 10);
+          if (end == listP)
+             break;
+          AppendUnique(pid);
+          listP = (*end == ',') ? end + 1 : end;
+          }
+    Sort(PidCompare);
+  }
   cString ListPids(void)
   {
     cString list = "";
@@ -62,8 +77,11 @@ public:
   cSatipTunerServer(const cSatipTunerServer &objP) { serverM = NULL; deviceIdM = -1; transponderM = 0; }
   cSatipTunerServer& operator= (const cSatipTunerServer &objP) { serverM = objP.serverM; deviceIdM = objP.deviceIdM; transponderM = objP.transponderM; return *this; }
   bool IsValid(void) { return !!serverM; }
+  cSatipServer *Server(void) { return serverM; }
+  int Transponder(void) { return transponderM; }
   bool IsQuirk(int quirkP) { return (serverM && cSatipDiscover::GetInstance()->IsServerQuirk(serverM, quirkP)); }
   bool HasCI(void) { return (serverM && cSatipDiscover::GetInstance()->HasServerCI(serverM)); }
+  bool IsAttached(void) { return (serverM && cSatipDiscover::GetInstance()->IsServerAttached(serverM)); }
   void Attach(void) { if (serverM) cSatipDiscover::GetInstance()->AttachServer(serverM, deviceIdM, transponderM); }
   void Detach(void) { if (serverM) cSatipDiscover::GetInstance()->DetachServer(serverM, deviceIdM, transponderM); }
   void Set(cSatipServer *serverP, const int transponderP) { serverM = serverP; transponderM = transponderP; }
@@ -101,6 +119,7 @@ private:
   cSatipRtsp rtspM;
   cSatipRtp rtpM;
   cSatipRtcp rtcpM;
+  cSatipTsMonitor monitorM;
   cString streamAddrM;
   cString streamParamM;
   cString lastAddrM;
@@ -130,6 +149,14 @@ private:
   cSatipPid addPidsM;
   cSatipPid delPidsM;
   cSatipPid pidsM;
+  cSatipPid sharedPidsM;
+  cString shareKeyM;
+  int shareRoleM;
+  int ownRtpPortM;
+  int ownRtcpPortM;
+  cString multicastAddrM;
+  cString multicastSrcM;
+  cString adoptedSessionM;
 
   bool Connect(void);
   bool Disconnect(void);
@@ -137,8 +164,13 @@ private:
   bool KeepAlive(bool forceP = false);
   bool ReadReceptionStatus(bool forceP = false);
   bool UpdatePids(bool forceP = false);
+  int JoinShare(void);
+  void PublishShare(void);
+  bool LeaveShare(void);
   void UpdateCurrentState(void);
   bool StateRequested(void);
+  bool PidsPending(void);
+  int RemainingMs(const cTimeMs &timerP);
   bool RequestState(eTunerState stateP, eStateMode modeP);
   const char *StateModeString(eStateMode modeP);
   const char *TunerStateString(eTunerState stateP);
@@ -162,10 +194,18 @@ public:
   bool HasLock(void);
   cString GetSignalStatus(void);
   cString GetInformation(void);
+  cString GetRtpInformation(void);
+  cString GetReceiveInformation(void);
+  cString GetMonitorInformation(void) { return monitorM.GetInformation(); }
+  cString GetPcrInformation(void) { return monitorM.GetPcrInformation(); }
+  void GetMetrics(satipMetrics &metricsP);
 
   // for internal tuner interface
 public:
-  virtual void ProcessVideoData(u_char *bufferP, int lengthP);
+  virtual void ProcessVideoData(u_char *bufferP, int lengthP, uint64_t arrivalP);
+  virtual u_char *GetVideoBuffer(int &lengthP);
+  virtual void AnalyzeVideoData(u_char *bufferP, int lengthP, uint64_t arrivalP);
+  virtual void CommitVideoData(u_char *bufferP, int lengthP);
   virtual void ProcessApplicationData(u_char *bufferP, int lengthP);
   virtual void ProcessRtpData(u_char *bufferP, int lengthP);
   virtual void ProcessRtcpData(u_char *bufferP, int lengthP);
@@ -173,6 +213,8 @@ public:
   virtual void SetSessionTimeout(const char *sessionP, int timeoutP);
   virtual void SetupTransport(int rtpPortP, int rtcpPortP, const char *streamAddrP, const char *sourceAddrP);
   virtual int GetId(void);
+  virtual void UpdateSharedPids(void);
+  virtual void AdoptSession(const char *sessionP, int streamIdP, int timeoutP);
 };
 
 #endif // __SATIP_TUNER_H
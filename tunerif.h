@@ -12,7 +12,10 @@ class cSatipTunerIf {
 public:
   cSatipTunerIf() {}
   virtual ~cSatipTunerIf() {}
-  virtual void ProcessVideoData(u_char *bufferP, int lengthP) = 0;
+  virtual void ProcessVideoData(u_char *bufferP, int lengthP, uint64_t arrivalP) = 0;
+  virtual u_char *GetVideoBuffer(int &lengthP) = 0;
+  virtual void AnalyzeVideoData(u_char *bufferP, int lengthP, uint64_t arrivalP) = 0;
+  virtual void CommitVideoData(u_char *bufferP, int lengthP) = 0;
   virtual void ProcessApplicationData(u_char *bufferP, int lengthP) = 0;
   virtual void ProcessRtpData(u_char *bufferP, int lengthP) = 0;
   virtual void ProcessRtcpData(u_char *bufferP, int lengthP) = 0;
@@ -20,6 +23,8 @@ public:
   virtual void SetSessionTimeout(const char *sessionP, int timeoutP) = 0;
   virtual void SetupTransport(int rtpPortP, int rtcpPortP, const char *streamAddrP, const char *sourceAddrP) = 0;
   virtual int GetId(void) = 0;
+  virtual void UpdateSharedPids(void) = 0;
+  virtual void AdoptSession(const char *sessionP, int streamIdP, int timeoutP) = 0;
 
 private:
   explicit cSatipTunerIf(const cSatipTunerIf&);
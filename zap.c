@@ -0,0 +1,178 @@
+/*
+ * zap.c: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include "config.h"
+#include "log.h"
+#include "zap.h"
+
+cSatipZapServer::cSatipZapServer(const char *nameP)
+: nameM(nameP)
+{
+  memset(countM, 0, sizeof(countM));
+  memset(samplesM, 0, sizeof(samplesM));
+}
+
+cSatipZapProfiler *cSatipZapProfiler::instanceS = NULL;
+
+cSatipZapProfiler *cSatipZapProfiler::GetInstance(void)
+{
+  if (!instanceS)
+     instanceS = new cSatipZapProfiler();
+  return instanceS;
+}
+
+bool cSatipZapProfiler::Initialize(void)
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+  // Created by the main thread before any device starts zapping
+  GetInstance();
+  return true;
+}
+
+void cSatipZapProfiler::Destroy(void)
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+  DELETE_POINTER(instanceS);
+}
+
+const char *cSatipZapProfiler::PhaseString(int phaseP)
+{
+  switch (phaseP) {
+    case SATIP_ZAP_PHASE_SERVER:
+         return "server";
+    case SATIP_ZAP_PHASE_OPTIONS:
+         return "options";
+    case SATIP_ZAP_PHASE_SETUP:
+         return "setup";
+    case SATIP_ZAP_PHASE_PLAY:
+         return "play";
+    case SATIP_ZAP_PHASE_RTP:
+         return "rtp";
+    case SATIP_ZAP_PHASE_LOCK:
+         return "lock";
+    case SATIP_ZAP_PHASE_DELIVERY:
+         return "delivery";
+    default:
+         break;
+    }
+
+  return "---";
+}
+
+cSatipZapProfiler::cSatipZapProfiler()
+: mutexM(),
+  serversM()
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+  memset(pendingM, 0, sizeof(pendingM));
+  memset(armedM, 0, sizeof(armedM));
+  memset(currentServerM, 0, sizeof(currentServerM));
+  for (int i = 0; i < SATIP_MAX_DEVICES; ++i) {
+      for (int j = 0; j < SATIP_ZAP_PHASE_COUNT; ++j)
+          lastMsM[i][j] = -1;
+      }
+}
+
+cSatipZapProfiler::~cSatipZapProfiler()
+{
+  debug1("%s", __PRETTY_FUNCTION__);
+}
+
+int cSatipZapProfiler::SortSamples(const void *data1P, const void *data2P)
+{
+  return (*(const int *)data1P - *(const int *)data2P);
+}
+
+void cSatipZapProfiler::Start(int deviceIdP)
+{
+  debug16("%s (%d)", __PRETTY_FUNCTION__, deviceIdP);
+  if ((deviceIdP < 0) || (deviceIdP >= SATIP_MAX_DEVICES))
+     return;
+  cMutexLock MutexLock(&mutexM);
+  startM[deviceIdP].Set(0);
+  currentServerM[deviceIdP] = NULL;
+  for (int i = 0; i < SATIP_ZAP_PHASE_COUNT; ++i)
+      lastMsM[deviceIdP][i] = -1;
+  // The stream phases are armed only by the request that switches the stream, as
+  // the previous transponder may still be flowing and locked until then
+  armedM[deviceIdP] = false;
+  __atomic_store_n(&pendingM[deviceIdP], (1U << SATIP_ZAP_PHASE_SERVER) | (1U << SATIP_ZAP_PHASE_OPTIONS) |
+                   (1U << SATIP_ZAP_PHASE_SETUP) | (1U << SATIP_ZAP_PHASE_PLAY), __ATOMIC_RELEASE);
+}
+
+bool cSatipZapProfiler::Mark(int deviceIdP, int phaseP, const char *serverP)
+{
+  // Keep the per-packet callers cheap until the next zap
+  if ((deviceIdP < 0) || (deviceIdP >= SATIP_MAX_DEVICES) || !(__atomic_load_n(&pendingM[deviceIdP], __ATOMIC_ACQUIRE) & (1U << phaseP)))
+     return false;
+  cMutexLock MutexLock(&mutexM);
+  if (!(pendingM[deviceIdP] & (1U << phaseP)))
+     return false;
+  __atomic_fetch_and(&pendingM[deviceIdP], ~(1U << phaseP), __ATOMIC_RELEASE);
+  if (((phaseP == SATIP_ZAP_PHASE_SETUP) || (phaseP == SATIP_ZAP_PHASE_PLAY)) && !armedM[deviceIdP]) {
+     armedM[deviceIdP] = true;
+     __atomic_fetch_or(&pendingM[deviceIdP], (1U << SATIP_ZAP_PHASE_RTP) | (1U << SATIP_ZAP_PHASE_LOCK) | (1U << SATIP_ZAP_PHASE_DELIVERY), __ATOMIC_RELEASE);
+     }
+  int elapsed = (int)startM[deviceIdP].Elapsed();
+  lastMsM[deviceIdP][phaseP] = elapsed;
+  if (serverP) {
+     cSatipZapServer *s = serversM.First();
+     while (s && strcmp(*s->nameM, serverP))
+           s = serversM.Next(s);
+     if (!s) {
+        s = new cSatipZapServer(serverP);
+        serversM.Add(s);
+        }
+     currentServerM[deviceIdP] = s;
+     }
+  if (cSatipZapServer *s = currentServerM[deviceIdP]) {
+     s->samplesM[phaseP][s->countM[phaseP] % cSatipZapServer::eMaxSamples] = elapsed;
+     s->countM[phaseP]++;
+     }
+  debug6("%s Zap phase %s reached in %d ms [device %d]", __PRETTY_FUNCTION__, PhaseString(phaseP), elapsed, deviceIdP);
+  return true;
+}
+
+cString cSatipZapProfiler::GetDeviceInformation(int deviceIdP)
+{
+  debug16("%s (%d)", __PRETTY_FUNCTION__, deviceIdP);
+  if ((deviceIdP < 0) || (deviceIdP >= SATIP_MAX_DEVICES))
+     return "";
+  cMutexLock MutexLock(&mutexM);
+  cString s = cString::sprintf("Last zap (%s):\n", currentServerM[deviceIdP] ? *currentServerM[deviceIdP]->nameM : "---");
+  for (int i = 0; i < SATIP_ZAP_PHASE_COUNT; ++i) {
+      if (lastMsM[deviceIdP][i] >= 0)
+         s = cString::sprintf("%s%-8s %5d ms\n", *s, PhaseString(i), lastMsM[deviceIdP][i]);
+      else
+         s = cString::sprintf("%s%-8s %5s ms\n", *s, PhaseString(i), "---");
+      }
+  return s;
+}
+
+cString cSatipZapProfiler::GetInformation(void)
+{
+  debug16("%s", __PRETTY_FUNCTION__);
+  cMutexLock MutexLock(&mutexM);
+  cString s = "";
+  for (cSatipZapServer *server = serversM.First(); server; server = serversM.Next(server)) {
+      s = cString::sprintf("%sServer: %s (%u zaps)\n%-8s %5s %5s %5s [ms]\n", *s, *server->nameM, server->countM[SATIP_ZAP_PHASE_SERVER], "Phase", "p50", "p95", "p99");
+      for (int i = 0; i < SATIP_ZAP_PHASE_COUNT; ++i) {
+          int n = min(server->countM[i], (unsigned int)cSatipZapServer::eMaxSamples);
+          if (n > 0) {
+             int samples[cSatipZapServer::eMaxSamples];
+             memcpy(samples, server->samplesM[i], n * sizeof(int));
+             qsort(samples, n, sizeof(int), SortSamples);
+             // nearest-rank percentiles
+             s = cString::sprintf("%s%-8s %5d %5d %5d\n", *s, PhaseString(i),
+                                  samples[(50 * n + 99) / 100 - 1], samples[(95 * n + 99) / 100 - 1], samples[(99 * n + 99) / 100 - 1]);
+             }
+          else
+             s = cString::sprintf("%s%-8s %5s %5s %5s\n", *s, PhaseString(i), "---", "---", "---");
+          }
+      }
+  return s;
+}
@@ -0,0 +1,58 @@
+/*
+ * zap.h: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __SATIP_ZAP_H
+#define __SATIP_ZAP_H
+
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+
+#include "common.h"
+
+class cSatipZapServer : public cListObject {
+public:
+  enum {
+    eMaxSamples = 128
+  };
+  cString nameM;
+  unsigned int countM[SATIP_ZAP_PHASE_COUNT];
+  int samplesM[SATIP_ZAP_PHASE_COUNT][eMaxSamples];
+  explicit cSatipZapServer(const char *nameP);
+};
+
+// Channel switch latency profiler: the time of each zap phase is measured from
+// SetChannelDevice() and the most recent samples are kept per SAT>IP server
+class cSatipZapProfiler {
+private:
+  static cSatipZapProfiler *instanceS;
+  cMutex mutexM;
+  cList<cSatipZapServer> serversM;
+  unsigned int pendingM[SATIP_MAX_DEVICES];
+  bool armedM[SATIP_MAX_DEVICES];
+  cTimeMs startM[SATIP_MAX_DEVICES];
+  int lastMsM[SATIP_MAX_DEVICES][SATIP_ZAP_PHASE_COUNT];
+  cSatipZapServer *currentServerM[SATIP_MAX_DEVICES];
+  static int SortSamples(const void *data1P, const void *data2P);
+  // constructor
+  cSatipZapProfiler();
+  // to prevent copy constructor and assignment
+  cSatipZapProfiler(const cSatipZapProfiler&);
+  cSatipZapProfiler& operator=(const cSatipZapProfiler&);
+
+public:
+  static cSatipZapProfiler *GetInstance(void);
+  static bool Initialize(void);
+  static void Destroy(void);
+  static const char *PhaseString(int phaseP);
+  virtual ~cSatipZapProfiler();
+  void Start(int deviceIdP);
+  bool Mark(int deviceIdP, int phaseP, const char *serverP = NULL);
+  cString GetDeviceInformation(int deviceIdP);
+  cString GetInformation(void);
+};
+
+#endif // __SATIP_ZAP_H